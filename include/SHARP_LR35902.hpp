@@ -1,5 +1,6 @@
 #pragma once
 #include "memory.hpp"
+#include "debug_probes.hpp"
 
 #include <stdint.h>
 #include <vector>
@@ -119,6 +120,10 @@ public:
 
     bool halted = false;
     bool stopped = false;
+
+    // Set while a debugger is attached. The probe is only filled then.
+    bool probe_enabled = false;
+    CPUProbe probe;
 private:
     Memory& memory;
     uint8_t current_cycle_count;
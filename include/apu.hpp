@@ -1,15 +1,20 @@
 #pragma once
 
-#include <SFML/Graphics.hpp>
-#include <SFML/Audio.hpp>
-
 #include <thread>
 #include <fstream>
 #include <iostream>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <array>
+#include <memory>
 
 #include "memory.hpp"
+#include "blip_buffer.hpp"
+#include "wav_recorder.hpp"
+#include "audio_sink.hpp"
+
+class Timer;
 
 // class SoundWaveStream : public sf::SoundStream
 // {
@@ -111,22 +116,19 @@ Sound Channel 1 (Pulse)
 
 */
 
-class APU : public sf::SoundStream
+class APU
 {
 public:
-    sf::Int16 samples[1024];
-    mutable std::vector<sf::Int16> ch1_sample_list;
-    mutable std::vector<sf::Int16> ch2_sample_list;
-    mutable std::vector<sf::Int16> ch3_sample_list;
-    mutable std::vector<sf::Int16> ch4_sample_list;
     bool duty_cycles[4][8];
     
     // Channel 1.
     bool ch1_active = false;
     int ch1_duty_pointer = 0;
     uint8_t ch1_duty_cycle = 0;
-    uint16_t ch1_duration = 0;
+    uint16_t ch1_duration = 0; // NR13/NR14. Registers are cached when they are written.
+    int ch1_timer = 4; // Dots until the duty pointer advances.
     int ch1_length_timer = 0;
+    bool ch1_length_enable = false;
 
     int ch1_volume = 0;
     int ch1_sweep_pace = 0;
@@ -134,13 +136,18 @@ public:
     int ch1_initial_sweep_pace = 0;
 
     int ch1_duration_sweep_pace = 0;
+    int ch1_sweep_register_pace = 0; // NR10.
+    int ch1_sweep_direction = 0;
+    int ch1_sweep_slope = 0;
 
     // Channel 2.
     bool ch2_active = false;
     int ch2_duty_pointer = 0;
     uint8_t ch2_duty_cycle = 0;
     uint16_t ch2_duration = 0;
+    int ch2_timer = 4;
     int ch2_length_timer = 0;
+    bool ch2_length_enable = false;
 
     int ch2_volume = 0;
     int ch2_sweep_pace = 0;
@@ -151,54 +158,135 @@ public:
     bool ch3_active = false;
     int ch3_sample_index = 0;
     int ch3_duration = 0;
+    int ch3_timer = 2;
     int ch3_current_sample = 0;
     int ch3_length_timer = 0;
+    bool ch3_length_enable = false;
 
     // Channel 4.
     bool ch4_active = false;
     int ch4_length_timer = 0;
-    uint16_t lfsr = 0;
+    bool ch4_length_enable = false;
+    int ch4_phase = 0; // LFSR clocks since the trigger, wrapped to the period of the LFSR.
+    bool ch4_lfsr_width = false; // 7 bit LFSR if set.
     int ch4_out = 0;
 
-    int ch4_frequency_timer = 1;
-    int ch4_frequency_counter = 0;
+    int ch4_frequency_timer = 8; // Dots per LFSR clock. Only derived when NR43 is written.
+    int ch4_timer = 8;
 
     int ch4_volume = 0;
     int ch4_sweep_pace = 0;
+    int ch4_direction = 0;
+    int ch4_initial_sweep_pace = 0;
 
     int ch4_debug_counter = 0;
 
     // General.
-    int sample_creation_cycles = 0;
-    uint64_t cycles = 0;
+    int64_t sample_creation_cycles = 0; // Dots * sample_rate since the last scope sample.
+
+    // Channel scopes for the debugger. Nothing is captured while they are disabled.
+    static const int scope_size = 4096;
+    bool scope_enabled = false;
 
     int sample_rate = 48000;
-    int sample_batch_size = 1024;
-    int sample_counter = 0;
 
     int cpu_frequency = 4194304.f;
     int div_apu = 0;
 
     uint64_t cycle_count_per_second = 0;
     uint64_t cycle_counter = 0;
+    uint64_t next_clock_check = 4096;
     std::chrono::_V2::system_clock::time_point cycles_per_second_timer;
 private:
     Memory& memory;
-    std::mutex& mutex;
-    std::ofstream out;
+    Timer& timer; // The frame sequencer is clocked by DIV.
+
+    // Where the samples go. Without a consumer (no sink using them and no recording) no samples are synthesized at all.
+    std::unique_ptr<AudioSink> sink;
+    bool synthesizing = false;
+
+    // Dynamic rate control. The output rate is corrected by up to max_rate_adjustment, so the buffer of the sink stays around its target fill.
+    static constexpr double max_rate_adjustment = 0.005;
+    double average_fill = 0;
+    double rate_adjustment = 0;
+
+    // Channel outputs are turned into samples through a band-limited buffer. Samples are read from it every frame_length dots.
+    BlipBuffer blip;
+    static const uint32_t frame_length = 4096;
+    uint32_t frame_clock = 0; // Dots since the start of the current frame.
+    std::array<int, 4> channel_amplitudes = {}; // Output of each channel as last handed to the buffer.
+
+    // Recording. When recording stems, every channel also gets its own band-limited buffer.
+    WavRecorder recorder;
+    bool recording_stems = false;
+    std::vector<BlipBuffer> stem_blips;
+
+    // Ring buffer of the channel outputs at the sample rate. scope_position is where the next sample is written.
+    std::array<std::array<int16_t, scope_size>, 4> scope_samples = {};
+    int scope_position = 0;
 public:
-    APU(Memory& p_emulator, std::mutex& p_mutex);
+    APU(Memory& p_emulator, Timer& p_timer);
     ~APU();
 
     void trigger(int p_channel);
-    void update();
-
-    virtual bool onGetData(Chunk& data);
-    virtual void onSeek(sf::Time timeOffset);
+    // Called by memory after a sound register was written.
+    void onRegisterWrite(uint16_t p_address);
+    // Called by memory before DIV is reset. Resetting DIV can clock the frame sequencer.
+    void onDIVReset();
+    // Advances the APU by p_cycles dots. Called by the emulator thread after each instruction.
+    void update(int p_cycles);
+
+    // Replaces the sink (a NullAudioSink at first). The new sink is started if the old one was playing.
+    void setSink(std::unique_ptr<AudioSink> p_sink);
+    void play();
+    void stop();
+    bool isPlaying() const;
+    void setVolume(float p_volume);
+    float getVolume() const;
 
     int getDigitalOutput(int p_channel);
+    uint16_t getLFSR() const;
+    /*
+    Copies the latest p_count samples (at most scope_size) of a channel's scope into p_samples, oldest first.
+    */
+    void getScopeSnapshot(int p_channel, int16_t* p_samples, int p_count) const;
+
+    // Seconds of audio played by the sink, negative if it doesn't play in real time.
+    double getAudioClock() const;
+    // Telemetry of the sink's buffer.
+    int getBufferFill() const;
+    uint64_t getUnderruns() const;
+    double getRateAdjustment() const;
+    double getLatency() const;
+    void setBufferSize(int p_samples);
+    int getBufferSize() const;
+
+    // Quality of the band-limited synthesis. Lower qualities are cheaper.
+    void setQuality(BlipBuffer::Quality p_quality);
+    BlipBuffer::Quality getQuality() const;
+
+    /*
+    Records the output into a WAV file. The files are written by a background thread.
+    @param p_stems Whether to also write one file per channel.
+    */
+    bool startRecording(const std::string& p_path, bool p_stems);
+    void stopRecording();
+    bool isRecording() const;
+    uint64_t getDroppedRecordingFrames() const;
     float getAnalogOutput(int p_channel);
 private:
+    // Processes all steps of the channel timers within the next p_cycles dots.
+    void runChannels(int p_cycles);
+    // Advances the LFSR by p_clocks and updates the output of channel 4.
+    void clockLFSR(int p_clocks);
+    // Hands a change of the channel output at p_clock to the band-limited buffer.
+    void updateAmplitude(int p_channel, uint32_t p_clock);
+    void endFrame();
+    // Turns the synthesis on or off, depending on whether anything consumes the samples.
+    void updateSynthesis();
+
+    // Steps the 512 Hz frame sequencer, which clocks the length timers, envelopes and the sweep.
+    void stepFrameSequencer();
     void lengthTimer();
     void volumeChange();
     void durationChange();
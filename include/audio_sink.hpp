@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+#include "wav_recorder.hpp"
+
+// Whether the SFML sink is built (CMake option EMULGATOR_SFML_AUDIO).
+#ifndef EMULGATOR_SFML_AUDIO
+#define EMULGATOR_SFML_AUDIO 1
+#endif
+
+/*
+AUDIO SINK
+
+Where the samples of the APU go. The APU only writes mono 16 bit samples into its sink, the sink decides what happens with them: playing
+them on an audio device, writing them into a file or dropping them. This keeps the core free of any audio device, so it can run headless.
+
+    APU -> write() -> NullAudioSink  (nothing, the APU doesn't even synthesize samples for it)
+                   -> WavAudioSink   (WAV file, written by a background thread)
+                   -> SFMLAudioSink  (sound card, see sfml_audio_sink.hpp)
+
+Sinks playing in real time also provide the clock the emulator is paced by and the fill of their buffer for the rate control of the APU.
+*/
+class AudioSink
+{
+protected:
+    float volume = 100.f;
+public:
+    virtual ~AudioSink() = default;
+
+    // Starts and stops the output. Samples are written at p_sample_rate.
+    virtual void start(int /*p_sample_rate*/) {}
+    virtual void stop() {}
+    virtual bool isPlaying() const { return false; }
+
+    // Whether the samples are used at all. If not, the APU only runs the channels and skips the band-limited synthesis.
+    virtual bool isConsuming() const { return true; }
+    // Called by the emulator thread. Must never block.
+    virtual void write(const int16_t* p_samples, int p_count) = 0;
+
+    /*
+    Seconds of audio played since start() or a negative value if the sink doesn't play in real time. The emulator is paced by this clock.
+    */
+    virtual double getClock() const { return -1; }
+    // Samples written but not played yet and the fill the rate control aims for. Sinks without a buffer return 0 for both.
+    virtual int getBufferFill() const { return 0; }
+    virtual int getTargetFill() const { return 0; }
+    virtual uint64_t getUnderruns() const { return 0; }
+    // Estimated seconds from writing a sample until it is heard.
+    virtual double getLatency() const { return 0; }
+
+    // Number of samples the sink hands to the device at once. Sinks without a device buffer ignore it.
+    virtual void setBufferSize(int /*p_samples*/) {}
+    virtual int getBufferSize() const { return 0; }
+
+    virtual void setVolume(float p_volume) { volume = p_volume; }
+    virtual float getVolume() const { return volume; }
+};
+
+// Drops everything. Used when nothing should be heard, e.g. when running headless.
+class NullAudioSink : public AudioSink
+{
+public:
+    bool isConsuming() const override { return false; }
+    void write(const int16_t* /*p_samples*/, int /*p_count*/) override {}
+};
+
+/*
+Writes the samples into a WAV file. The file is written by the background thread of a WavRecorder, so writing never waits for the disk.
+Nothing is played, so the emulator is paced by the system clock (or runs as fast as it can).
+The file is created by the first start() and finished when the sink is destroyed. stop() and start() only pause and resume writing, so 
+pausing the emulator doesn't lose what was recorded so far.
+*/
+class WavAudioSink : public AudioSink
+{
+private:
+    std::string path;
+    WavRecorder recorder;
+    bool playing = false;
+public:
+    WavAudioSink(const std::string& p_path);
+    ~WavAudioSink();
+
+    void start(int p_sample_rate) override;
+    void stop() override;
+    bool isPlaying() const override;
+    void write(const int16_t* p_samples, int p_count) override;
+};
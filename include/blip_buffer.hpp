@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+BAND-LIMITED SYNTHESIS
+
+Instead of point-sampling the channels at the output rate (which aliases every edge of the square waves), channels only report the change
+of their amplitude (delta) and the exact clock it happened at. Each delta is added to the buffer as a band-limited step: a windowed sinc
+impulse which is later integrated back into a step. The impulse is precomputed for 32 sub-sample positions (phases) of the step, which
+makes this a polyphase FIR filter that only runs where the input changes.
+
+    delta at clock t -> sample position t * sample_rate / clock_rate -> impulse of that phase added to width samples -> integrate -> output
+
+Clocks are counted from the start of the current frame. Ending a frame makes all samples before its end readable. The output is delayed
+by half the width of the impulse, since a step also influences the samples right before it.
+Adding an impulse is vectorised with SSE (4 taps at once), the widths are multiples of 4.
+*/
+class BlipBuffer
+{
+public:
+    /*
+    The quality is the half width of the impulse. Wider impulses have a steeper cutoff (less aliasing, less muffled highs), but every delta
+    costs more. LOW is meant for running far faster than real time.
+    */
+    enum Quality { LOW = 4, MEDIUM = 8, HIGH = 16 };
+
+    static const int phase_bits = 5;
+    static const int phase_count = 1 << phase_bits;
+    static const int max_width = HIGH * 2;
+    static const int bass_shift = 9; // Strength of the high-pass removing the DC offset (like the capacitor on the real output).
+private:
+    std::vector<float> buffer;
+    std::vector<float> kernel; // Taps of all phases, phase after phase.
+    Quality quality;
+    int width;
+
+    uint64_t factor; // Samples per clock as 32.32 fixed point.
+    uint64_t offset = 0; // Sample position of the current frame start as 32.32 fixed point.
+    float integrator = 0;
+public:
+    /*
+    @param p_size Number of samples the buffer can hold. Samples have to be read before more than that are available.
+    */
+    BlipBuffer(double p_clock_rate, double p_sample_rate, int p_size, Quality p_quality = MEDIUM);
+
+    void setRates(double p_clock_rate, double p_sample_rate);
+    // Switching the quality while deltas are pending causes a short glitch, since their impulses had another width.
+    void setQuality(Quality p_quality);
+    Quality getQuality() const;
+
+    // Adds a change of the amplitude by p_delta at p_clock (relative to the start of the frame).
+    void addDelta(uint32_t p_clock, int p_delta);
+    // Ends the current frame after p_clocks. The next frame starts there.
+    void endFrame(uint32_t p_clocks);
+
+    int getSamplesAvailable() const;
+    // Reads up to p_count samples and returns how many were read.
+    int readSamples(int16_t* p_samples, int p_count);
+    void clear();
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <array>
+
+/*
+DEBUG PROBES
+
+The debugger shows internal state of the PPU and CPU that is not visible through memory (the last tile fetch, the last executed instruction, ...).
+This state is captured into fixed-size probe structs, but only while the debugger shows it. Release builds set EMULGATOR_DEBUG_PROBES 
+to 0, which removes the capturing code entirely (the CMake option of the same name keeps it in every build type).
+*/
+
+#ifndef EMULGATOR_DEBUG_PROBES
+#ifdef NDEBUG
+#define EMULGATOR_DEBUG_PROBES 0
+#else
+#define EMULGATOR_DEBUG_PROBES 1
+#endif
+#endif
+
+constexpr bool debug_probes_enabled = EMULGATOR_DEBUG_PROBES;
+
+struct PPUProbe
+{
+    // Last background or window tile fetch.
+    int tile_x = 0;
+    int tile_y = 0;
+    int tile_row = 0;
+    uint16_t tile_map_address = 0;
+    uint8_t tile_index = 0;
+    uint16_t tile_data_address = 0;
+    uint8_t tile_data_low = 0;
+    uint8_t tile_data_high = 0;
+
+    // FIFO colors after the last fetch.
+    int fifo_size = 0;
+    std::array<uint8_t, 16> fifo_colors = {};
+
+    // Objects found by the last OAM scan.
+    int object_count = 0;
+    std::array<uint8_t, 10> object_x = {};
+    std::array<uint8_t, 10> object_y = {};
+};
+
+struct CPUProbe
+{
+    // Last executed instruction.
+    uint16_t address = 0;
+    uint8_t opcode = 0;
+    bool prefixed = false;
+    uint8_t cycles = 0;
+    uint64_t instruction_count = 0;
+};
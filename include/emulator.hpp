@@ -9,19 +9,24 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 
 class Emulator
 {
 public:
     uint64_t cycle_count_per_second = 0;
-    int cycle_budget = 0;
 private:
     std::thread thread;
     std::mutex& mutex; // Protects shared data by main thread and emulator thread.
 
     std::atomic<bool> thread_finished;
     std::atomic<bool> enabled = false; // Whether the emulator is running (at start set to false); meaning the cpu executes instructions, ppu processes pictures and so on.
+    bool cartridge_loaded = false;
+    // The worker sleeps on this while it has nothing to do. Changes of thread_finished, enabled and cartridge_loaded are made while holding
+    // worker_mutex, so the worker can't miss them.
+    std::mutex worker_mutex;
+    std::condition_variable worker_condition;
 
     uint8_t cycles_since_last_instruction = 0; // After executing a step and therefore a cpu instruction this will contain the number of cycles that was needed for the operation.
     
@@ -29,8 +34,14 @@ private:
     std::chrono::_V2::system_clock::time_point cycles_per_second_timer;
 
     float cpu_frequency = 4194304.f;
-    float frequency_percentage = 100.f;
-    std::chrono::_V2::system_clock::time_point step_duration_timer;
+    std::atomic<float> frequency_percentage = 100.f;
+
+    // Pacing. Only touched by the worker. Other threads request a resynchronisation (after changing the speed, the sink, ...) through
+    // pacing_resync, which the worker consumes before its next slot.
+    int cycle_budget = 0;
+    double pacing_time = 0; // Last reading of the pacing clock in seconds.
+    std::atomic<bool> pacing_resync = false;
+    std::atomic<int> reported_cycle_budget = 0; // cycle_budget after the last slot, for the UI.
 
     Memory memory;
     SHARP_LR35902 cpu;
@@ -43,9 +54,9 @@ public:
     ~Emulator();
 
     /*
-    Updates the screen buffers of the emulator. Information the screen buffers can be retrieved though the debug information.
+    Updates the background and window views of the PPU if they are shown. Only changed parts are redrawn. Has to be called with the mutex locked.
     */
-    void processScreenBuffers();
+    void processScreenBuffers(bool p_background, bool p_window);
 
     void reset();
     void loadCartridge(const std::string& p_string);
@@ -54,16 +65,41 @@ public:
 
     void setSpeed(int p_percentage);
     int getSpeed();
+    // Cycles the emulator was ahead (negative) or behind after its last slot.
+    int getCycleBudget() const;
+    // Draws only every p_frame_skip-th frame (0 only draws requested frames). Skipped frames are still emulated exactly.
+    void setFrameSkip(int p_frame_skip);
+    int getFrameSkip();
+    void requestFrame();
+    // Format of the frames returned by getLatestFrame(). Palette indices by default, RGBA8888 to show them.
+    void setOutputFormat(PPU::OutputFormat p_format);
+    // Sets where the audio goes. Without a sink nothing is synthesized, which is what headless instances want.
+    void setAudioSink(std::unique_ptr<AudioSink> p_sink);
     void setVolume(float p_volume);
     float getVolume();
+    // Samples handed to the audio device at once. Smaller buffers lower the latency, but underrun sooner.
+    void setAudioBufferSize(int p_samples);
+    int getAudioBufferSize();
+    // Quality of the audio synthesis. Running much faster than real time can use BlipBuffer::LOW.
+    void setAudioQuality(BlipBuffer::Quality p_quality);
+    BlipBuffer::Quality getAudioQuality();
+    // Records the audio output into p_path (and one file per channel with p_stems). Files are written in the background.
+    void startRecording(const std::string& p_path, bool p_stems);
+    void stopRecording();
 
     const Memory& getMemory();
     const SHARP_LR35902& getCPU();
     const PPU& getPPU();
+    // Latest frame completed by the PPU. Can be called without locking the mutex.
+    const PPU::Frame& getLatestFrame();
     const APU& getAPU();
 
     void setEnabled(bool p_state);
     bool isEnabled() const;
+    // Makes the PPU and CPU fill their debug probes. Should only be enabled while the debugger shows them, otherwise nothing is captured.
+    void attachDebugger(bool p_ppu, bool p_cpu);
+    // Makes the APU capture its channel scopes. Should only be enabled while they are shown.
+    void enableChannelScopes(bool p_state);
     /*
     Executes one simulation step of the gameboy. One cpu instruction is executed and other hardware updates accordingly.
     */
@@ -71,8 +107,15 @@ public:
 private:
     /*
     Runs the emulator as long as thread_finished is false. It is run in a different thread to keep the emulator clean from debugging/ui code which slows it down.
+    While stopped or without a cartridge it blocks until setEnabled() or loadCartridge() wake it up. Between the slots of the pacing it 
+    blocks until the next slot is due.
     */
     void worker();
 
+    /*
+    Clock the emulator is paced by. While the audio sink plays in real time this is its clock, so samples are made exactly as fast as they
+    are played. Otherwise it is the system clock.
+    */
+    double getPacingClock();
     void executeInterrupt(SHARP_LR35902::Interrupt p_type, uint16_t address);
 };
\ No newline at end of file
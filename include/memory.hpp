@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <array>
 #include <string>
 
 class PPU;
@@ -201,9 +202,18 @@ public:
         const NoMBC& no_mbc;
         const MBC1& mbc1;
     };
+    // Write to a PPU register during mode 3. The cycle is the PPU cycle of the scanline at which the write happened.
+    struct RegisterWrite
+    {
+        uint32_t cycle;
+        uint16_t address;
+        uint8_t value;
+    };
+    static const int register_write_capacity = 32;
 private:
     std::vector<uint8_t> internal_memory;
     Cartridge cartridge;
+    bool cartridge_loaded = false;
 
     NoMBC no_mbc;
     MBC1 mbc1;
@@ -215,6 +225,9 @@ private:
     std::vector<std::string> cartridge_type_lookup;
     std::vector<std::string> rom_lookup;
     std::vector<std::string> ram_lookup;
+
+    std::array<RegisterWrite, register_write_capacity> register_writes;
+    int register_write_count = 0;
 public:
     Memory(PPU& p_ppu, APU& p_apu, Timer& p_timer);
 
@@ -225,6 +238,12 @@ public:
 
     void loadCartridge(const std::string& p_file_path);
     const Cartridge& getCartridge() const;
+    bool isCartridgeLoaded() const;
+
+    // Log of the writes to PPU registers during mode 3 of the current scanline. Cleared by the PPU at the start of mode 3.
+    int getRegisterWriteCount() const;
+    const RegisterWrite& getRegisterWrite(int p_index) const;
+    void clearRegisterWrites();
 private:
     void loadHeader(const std::string& p_file_path);
 
@@ -1,6 +1,8 @@
 #pragma once
 #include "SHARP_LR35902.hpp"
 #include "memory.hpp"
+#include "debug_probes.hpp"
+#include "triple_buffer.hpp"
 
 #include <stdint.h>
 #include <vector>
@@ -48,10 +50,43 @@ public:
     };
     struct Pixel
     {
-        int color = 0; // Value between 0-3.
-        int palette = 0;
-        bool background_priority = false;
+        uint8_t color : 2; // Value between 0-3.
+        uint8_t palette : 2;
+        uint8_t background_priority : 1;
     };
+    /* 
+    Ring buffer holding the pixels of the FIFO. The FIFO never holds more than 16 pixels (8 pixels waiting to be pushed out and 8 freshly 
+    fetched pixels), so pushing, popping and discarding pixels only moves the head or the size.
+    */
+    class PixelFIFO
+    {
+    public:
+        static const int capacity = 16;
+    private:
+        std::array<Pixel, capacity> pixels;
+        int head = 0;
+        int count = 0;
+    public:
+        void push(const Pixel& p_pixel) { pixels[(head + count) & (capacity - 1)] = p_pixel; count++; }
+        void pop() { discard(1); }
+        void discard(int p_count) { head = (head + p_count) & (capacity - 1); count -= p_count; }
+        void clear() { head = 0; count = 0; }
+        int size() const { return count; }
+
+        Pixel& front() { return pixels[head]; }
+        Pixel& operator[](int p_index) { return pixels[(head + p_index) & (capacity - 1)]; }
+        const Pixel& operator[](int p_index) const { return pixels[(head + p_index) & (capacity - 1)]; }
+    };
+    // The 160x144 pixels of the LCD in the output format of the PPU.
+    typedef std::array<uint32_t, 160 * 144> Frame;
+    /*
+    Format of the pixels in a Frame. PALETTE_INDEX holds the shade (0-3) of each pixel after the palettes were applied, which is all a 
+    headless user or a comparison of frames needs. RGBA8888 holds the color of the shade (bytes in the order R, G, B, A), ready to be 
+    uploaded to a texture.
+    */
+    enum OutputFormat { PALETTE_INDEX, RGBA8888 };
+    // Color indices of the 8 pixels in a row of a tile, from left to right.
+    typedef std::array<uint8_t, 8> TileRow;
     enum LCDC
     {
         LCD_AND_PPU_ENABLE              = 1 << 7, // Turns display on or off.
@@ -85,9 +120,27 @@ public:
     const int actual_screen_width = 256;
     const int actual_screen_height = 256;
 
-    std::vector<uint8_t> screen_buffer;
-    std::vector<uint8_t> background_buffer;
-    std::vector<uint8_t> window_buffer;
+    // Frame currently drawn by the PPU. Completed frames are published at the start of VBLANK.
+    uint32_t* screen_buffer;
+    /*
+    Debugger view of a tile map (256x256 pixels as RGBA8888). Views are only built when requested and then only redraw the map entries whose 
+    tile index or tile data changed since they were drawn.
+    */
+    struct TileMapView
+    {
+        std::vector<uint32_t> pixels;
+        bool built = false;
+        // Tile map (0 = 9800, 1 = 9C00) and tile data area the view was built with.
+        bool tile_map = false;
+        bool tile_data = false;
+        uint32_t vram_version = 0;
+        std::array<uint16_t, 1024> drawn_tiles;     // Tile (0-383) drawn at each map entry.
+        std::array<uint32_t, 1024> drawn_versions;  // Version of that tile when it was drawn.
+        std::array<bool, 1024> dirty_entries;       // Map entries written since they were drawn.
+    };
+    TileMapView background_view;
+    TileMapView window_view;
+    // Decoded copy of OAM. Entries are decoded again when OAM is written (directly or by DMA).
     std::array<Object, 40> objects;
 private:
     uint32_t cycles = 0;
@@ -95,7 +148,14 @@ private:
     Memory& memory;
     SHARP_LR35902& cpu;
 
+    TripleBuffer<Frame> frames;
+
     std::array<uint32_t, 4> color_palette;
+    // The colors of color_palette as RGBA8888 pixels.
+    std::array<uint32_t, 4> rgba_palette;
+    // Pixel written to the LCD for each shade. Either the shade itself or rgba_palette, depending on the output format.
+    OutputFormat output_format = PALETTE_INDEX;
+    std::array<uint32_t, 4> output_palette = { 0, 1, 2, 3 };
 
     const uint16_t tile_data_01_pointer = 0x8000;
     const uint16_t tile_data_12_pointer = 0x9000;
@@ -105,21 +165,62 @@ private:
     const uint16_t oam_start = 0xfe00;
     const uint16_t oam_end = 0xfe9f;
 
+    // LCD registers. Memory routes reads and writes of 0xff40-0xff45 and 0xff47-0xff4b to the PPU.
+    uint8_t lcdc_register = 0x00;       // 0xff40
+    uint8_t stat_register = 0x00;       // 0xff41
+    uint8_t scroll_y_register = 0x00;   // 0xff42
+    uint8_t scroll_x_register = 0x00;   // 0xff43
+    uint8_t ly_register = 0x00;         // 0xff44
+    uint8_t lyc_register = 0x00;        // 0xff45
+    uint8_t bgp_register = 0x00;        // 0xff47
+    uint8_t obp0_register = 0x00;       // 0xff48
+    uint8_t obp1_register = 0x00;       // 0xff49
+    uint8_t window_y_register = 0x00;   // 0xff4a
+    uint8_t window_x_register = 0x00;   // 0xff4b
+
+    /*
+    Decoded tile data. Each of the 384 tiles in 0x8000-0x97ff has 8 rows, which are stored once as they are and once flipped horizontally. 
+    Rows are marked dirty by VRAM writes and decoded again the next time they are read.
+    */
+    mutable std::array<TileRow, 384 * 8> tile_rows;
+    mutable std::array<TileRow, 384 * 8> flipped_tile_rows;
+    mutable std::array<bool, 384 * 8> dirty_tile_rows;
+
+    // Incremented on every VRAM write. The version of a tile is incremented when its data is written.
+    uint32_t vram_version = 0;
+    std::array<uint32_t, 384> tile_versions = {};
+
+    /*
+    Objects intersecting each visible line, as indices into objects in OAM order. Like the OAM scan, a line holds at most 10 objects.
+    The buckets are rebuilt before the next OAM scan when an object was moved or the object size changed.
+    */
+    struct ObjectBucket
+    {
+        std::array<uint8_t, 10> objects;
+        int count = 0;
+    };
+    std::array<ObjectBucket, 144> object_buckets;
+    bool object_buckets_dirty = true;
+    bool object_buckets_tall = false;
+
 
 public:
-    std::vector<Pixel> fifo;
+    PixelFIFO fifo;
     int output_x = -8;
     int output_y = 0;
     bool lock_fifo = false;
     int fetcher_x = 0;
     int fetcher_y = 0;
 
-    std::vector<Object> objects_on_scanline;
+    // Objects on the current scanline, sorted by x position (OAM order for objects on the same x position).
+    std::array<Object, 10> objects_on_scanline;
+    int object_count = 0;
+    // Object pixels of the current scanline (pixels -8 to 159), composed at the end of mode 2. Color 0 marks pixels without an object.
+    std::array<Pixel, 168> object_layer;
 
     int fetcher_cycles = 0;
     uint8_t scroll_x = 0;
     uint8_t scroll_y = 0;
-    std::string info_text;
 
     uint8_t window_x = 0;
     uint8_t window_y = 0;
@@ -128,8 +229,36 @@ public:
     bool window_on_scanline = false;
     bool window_triggered = false;
 
+    // Whether scanlines are drawn in one pass at the end of mode 3 instead of dot by dot through the FIFO.
+    bool scanline_renderer_enabled = true;
+    // Set while the current scanline is drawn by the scanline renderer. Cleared when a register write forces the FIFO to take over.
+    bool scanline_in_bulk = false;
+    // Cycle at which the last pixel of the current scanline is pushed to the LCD (and mode 3 ends).
+    uint32_t drawing_end_cycle = 0;
+    // Pixel at which the window starts on the current scanline (160 if it doesn't).
+    int drawing_window_start = 160;
+    // Registers 0xff40-0xff4b at the start of mode 3.
+    std::array<uint8_t, 12> drawing_registers;
+
+    /*
+    Only every frame_skip-th frame is drawn (1 draws every frame), 0 only draws frames requested with requestFrame(). Skipped frames keep modes, 
+    interrupts, LY and the window line counter exact, but no tiles or objects are fetched and no pixels are pushed out or published.
+    */
+    int frame_skip = 1;
+    // Whether the current frame is drawn.
+    bool drawing_frame = true;
+
+    // Set while a debugger is attached. The probe is only filled then.
+    bool probe_enabled = false;
+    PPUProbe probe;
+private:
+    int frames_until_drawing = 0;
+    bool frame_requested = false;
+
 public:
     PPU(Memory& p_memory, SHARP_LR35902& p_cpu);
+    // Sets the LCD registers to the values the boot ROM leaves behind (LCD on, BGP = 0xfc) and starts a new frame at line 0.
+    void reset();
     
     void setLCDCBit(LCDC p_mask, bool p_state);
     bool getLCDCBit(LCDC p_mask) const;
@@ -140,18 +269,67 @@ public:
     void setLCDMode(LCDMODE p_state);
     LCDMODE getLCDMode() const;
 
+    // Whether p_address is one of the LCD registers owned by the PPU (0xff46, OAM DMA, is handled by memory).
+    static bool isRegister(uint16_t p_address);
+    uint8_t readRegister(uint16_t p_address) const;
+    void writeRegister(uint16_t p_address, uint8_t p_value);
+
     const std::array<uint32_t, 4>& getColorPalette() const;
+    // Takes effect with the next pixel, so the current frame can be a mix of both formats.
+    void setOutputFormat(OutputFormat p_format);
+    OutputFormat getOutputFormat() const;
     uint32_t getCycleCount() const;
 
-    void processScreenBuffers();
+    // Returns the latest completed frame. Only to be called from one (the UI) thread, it never waits for the PPU.
+    const Frame& getLatestFrame();
+
+    // Brings the background and window tile map views up to date. Views that aren't shown can be skipped.
+    void processScreenBuffers(bool p_background, bool p_window);
     void update();
+
+    // Draws the next frame regardless of frame_skip.
+    void requestFrame();
+
+    /*
+    Called by memory before a register the pixel pipeline reads while drawing (LCDC, palettes, WX) is written. Most writes during mode 3 are 
+    replayed by the scanline renderer from the register write log. For writes that change the timing of mode 3, the FIFO is caught up to the 
+    current dot and draws the rest of the scanline. Skipped frames draw nothing, they only move the end of mode 3.
+    */
+    void onRegisterWrite(uint16_t p_address, uint8_t p_value);
     
     void getTile(uint16_t p_address, std::vector<uint8_t>& p_pixels) const;
+
+    // Called by memory after VRAM was written. Marks the tile row or tile map entry at p_address as dirty.
+    void onVRAMWrite(uint16_t p_address);
+    // Returns a decoded row (0-7) of a tile (0-383, counted from 0x8000).
+    const TileRow& getTileRow(int p_tile_number, int p_row, bool p_flip) const;
+    int getTileNumber(uint16_t p_address) const;
+
+    // Called by memory after OAM was written. Decodes the object at p_address again.
+    void onOAMWrite(uint16_t p_address);
 private:
-    void tryFetchingObject(int p_x);
-    void fetchTile();
+    // Composes the objects at or right of p_start_x into the object layer, starting at pixel p_start_x.
+    void composeObjectLayer(int p_start_x);
+    // Called when LCDC bit 7 changes. Resets LY, the mode and the drawing state.
+    void switchLCD(bool p_on);
+    void startFrame();
+    void findObjects();
+    void fetchTile(uint32_t p_cycle);
+    void probeFetch(int p_tile_x, int p_tile_y, int p_tile_row, uint16_t p_tile_map_address, uint16_t p_tile_data_address);
+
+    void drawPixel(uint32_t p_cycle);
+    void endDrawing();
+
+    // Value of a register at p_cycle of the current scanline.
+    uint8_t readDrawingRegister(uint16_t p_address, uint32_t p_cycle) const;
+    bool getDrawingLCDCBit(LCDC p_mask, uint32_t p_cycle) const;
+
+    int getWindowStart() const;
+    void moveWindowStart(uint16_t p_address, uint8_t p_value);
+    uint32_t getOutputCycle(int p_x) const;
+    uint32_t getFetchCycle(int p_x) const;
+    void renderScanline();
 
-    void writeTileToBuffer(int start_x, int start_y, std::vector<uint8_t>& tile, std::vector<uint8_t>& buffer, int buffer_size_x, int buffer_size_y, bool is_transparent, bool flip_x, bool flip_y); 
-    void writeTileMapToBuffer(bool p_tile_map, bool p_tile_data, std::vector<uint8_t>& buffer, int buffer_size_x, int buffer_size_y);
-    void writeOAMToBuffer();
+    void updateTileMapView(TileMapView& p_view, bool p_tile_map, bool p_tile_data);
+    void updateObjectBuckets();
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <atomic>
+
+/*
+RING BUFFER
+
+Hands a stream of values (e.g. audio samples) from one writer thread to one reader thread without locking. The writer only moves the write
+index, the reader only moves the read index. Each side reads the index of the other side to know how much it may write or read.
+The capacity has to be a power of 2 so the indices can simply count up and wrap around. A full buffer rejects new values instead of
+overwriting ones the reader hasn't seen yet.
+*/
+template <typename T, size_t N>
+class RingBuffer
+{
+    static_assert((N & (N - 1)) == 0, "Ring buffer capacity has to be a power of 2.");
+private:
+    static const size_t index_mask = N - 1;
+
+    std::array<T, N> buffer = {};
+    std::atomic<size_t> write_index = 0;
+    std::atomic<size_t> read_index = 0;
+public:
+    // Called by the writer. Returns false if the buffer is full and p_value was dropped.
+    bool push(const T& p_value)
+    {
+        size_t write = write_index.load(std::memory_order_relaxed);
+        if(write - read_index.load(std::memory_order_acquire) >= N)
+        {
+            return false;
+        }
+        buffer[write & index_mask] = p_value;
+        write_index.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Called by the reader. Copies up to p_count values into p_values and returns how many were copied.
+    size_t pop(T* p_values, size_t p_count)
+    {
+        size_t read = read_index.load(std::memory_order_relaxed);
+        size_t available = write_index.load(std::memory_order_acquire) - read;
+        size_t count = available < p_count ? available : p_count;
+        for (size_t i = 0; i < count; i++)
+        {
+            p_values[i] = buffer[(read + i) & index_mask];
+        }
+        read_index.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // Number of values waiting to be read. Only exact when called by the reader or writer.
+    size_t size() const
+    {
+        return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <SFML/Audio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "audio_sink.hpp"
+#include "ring_buffer.hpp"
+
+/*
+Plays the samples on the sound card through an sf::SoundStream. The emulator thread pushes samples into a lock-free ring, SFML's audio
+thread pulls them out in chunks of sample_batch_size. The number of samples pulled is the audio clock.
+The latency is mostly the chunk size: SFML keeps device_buffer_count chunks queued and the rate control keeps about 2 more in the ring.
+Small chunks (low latency) need the emulator thread to deliver samples in time, otherwise they underrun.
+Only built with EMULGATOR_SFML_AUDIO, the rest of the emulator doesn't depend on SFML's audio module.
+*/
+class SFMLAudioSink : public AudioSink, private sf::SoundStream
+{
+public:
+    static const int min_batch_size = 128;
+    static const int max_batch_size = 4096;
+    static const int default_batch_size = 1024;
+    static const int low_latency_batch_size = 256; // ~5 ms at 48 kHz.
+    static const int device_buffer_count = 3; // Chunks queued by SFML.
+private:
+    int sample_batch_size;
+    std::vector<sf::Int16> samples; // Chunk handed to SFML. Only accessed by the audio thread.
+    sf::Int16 last_sample = 0;
+    int sample_rate = 48000;
+
+    // Samples generated by the emulator thread, waiting to be played by the audio thread. Sized from the largest chunk, so the target
+    // fill of the rate control stays well below the capacity at every batch size.
+    RingBuffer<sf::Int16, 4 * max_batch_size> sample_ring;
+    static_assert(2 * max_batch_size < decltype(sample_ring)::capacity(), "The target fill has to fit into the sample ring.");
+
+    // Audio clock. Written by the audio thread whenever SFML pulls a chunk.
+    std::atomic<uint64_t> samples_played = 0;
+    std::atomic<int64_t> last_pull_time = 0; // Nanoseconds of std::chrono::steady_clock.
+    std::atomic<uint64_t> underruns = 0;
+public:
+    SFMLAudioSink(int p_batch_size = default_batch_size);
+    ~SFMLAudioSink();
+
+    void start(int p_sample_rate) override;
+    void stop() override;
+    bool isPlaying() const override;
+    // Dropped if the audio thread can't keep up (e.g. when running faster than 100%).
+    void write(const int16_t* p_samples, int p_count) override;
+
+    // Advances in between the chunks pulled by SFML, so it can pace the emulator smoothly.
+    double getClock() const override;
+    int getBufferFill() const override;
+    int getTargetFill() const override;
+    uint64_t getUnderruns() const override;
+    double getLatency() const override;
+
+    // Restarts the stream if it is playing, since the audio thread uses the chunk.
+    void setBufferSize(int p_samples) override;
+    int getBufferSize() const override;
+
+    void setVolume(float p_volume) override;
+    float getVolume() const override;
+private:
+    // Called by SFML's audio thread. Only copies samples out of the sample ring and never blocks the emulator.
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+};
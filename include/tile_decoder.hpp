@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+/*
+TILE DECODING
+
+Tiles are stored with 2 bits per pixel (2bpp). Each row of 8 pixels takes 2 bytes: the first byte holds the lower bit of every color index,
+the second byte the upper bit. The leftmost pixel is stored in bit 7.
+
+    low  byte: 0 1 1 1 1 1 0 0
+    high byte: 0 1 1 0 0 1 1 0
+    pixels:    0 3 3 1 1 3 2 0
+
+Decoding spreads the 8 bits of each byte into 8 bytes and combines both planes. The spread bytes come from two 256 entry tables (4 KiB),
+one for each direction of the row.
+*/
+
+/*
+Decodes a tile row into 8 color indices (0-3), from left to right.
+@param p_flip Whether the row should be flipped horizontally.
+*/
+void decodeTileRow(uint8_t p_low, uint8_t p_high, uint8_t* p_pixels, bool p_flip = false);
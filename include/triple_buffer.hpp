@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+/*
+TRIPLE BUFFER
+
+Hands completed data (e.g. frames) from one writer thread to one reader thread without locking. There are 3 buffers:
+- The back buffer is only accessed by the writer.
+- The front buffer is only accessed by the reader.
+- The middle buffer holds the latest published data.
+Publishing swaps the back buffer with the middle buffer, reading swaps the middle buffer with the front buffer if something new was published.
+Neither side ever waits for the other one. The reader always gets the latest complete buffer, buffers that were never read are skipped.
+*/
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const uint8_t index_mask = 0b011;
+    static const uint8_t fresh_bit = 0b100; // Set in middle when it holds data the reader hasn't seen yet.
+
+    std::array<T, 3> buffers = {};
+    uint8_t back = 0;
+    std::atomic<uint8_t> middle = 1;
+    uint8_t front = 2;
+public:
+    // Buffer the writer fills next.
+    T& getBackBuffer() { return buffers[back]; }
+
+    // Makes the back buffer the latest data and continues with another buffer (which holds older data).
+    void publish() 
+    { 
+        back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask; 
+    }
+
+    // Returns the latest published data. The returned buffer stays valid until the next call.
+    const T& getFrontBuffer()
+    {
+        if(middle.load(std::memory_order_relaxed) & fresh_bit)
+        {
+            front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        }
+        return buffers[front];
+    }
+};
@@ -63,6 +63,7 @@ private:
     ui::TextField* cartridge_text;
     ui::Button* play_button;
     ui::TextField* speed_text;
+    ui::TextField* frame_skip_text;
     ui::TextField* metrics_text;
     std::array<int, 6> speed_options;
 
@@ -95,10 +96,15 @@ private:
     ui::TextField* apu_ch4;
     ui::TextField* apu_general;
     ui::TextField* volume_text;
+    ui::TextField* buffer_size_text;
     FunctionGraph* ch1_graph;
     FunctionGraph* ch2_graph;
     FunctionGraph* ch3_graph;
     FunctionGraph* ch4_graph;
+    bool channel_scopes_enabled = false;
+    bool ppu_probe_enabled = false;
+    bool cpu_probe_enabled = false;
+    std::array<sf::Int16, 3200> scope_snapshot;
 
     std::mutex& mutex;
 public:
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+WAV RECORDER
+
+Records audio into 16 bit mono WAV files without doing any disk I/O on the thread producing the samples. Samples are collected in blocks,
+full blocks are queued and a writer thread writes them to disk. The blocks come from a fixed pool, so memory stays bounded: if the writer
+falls behind and no block is free, samples are dropped (and counted) instead of allocating more.
+The pool and the writer thread only exist during a recording. The writer releases the pool and ends once the files are finished.
+
+A recording either has 1 stream (the mix) or one stem per stream, each written into its own file:
+
+    recording.wav -> recording_mix.wav, recording_ch1.wav, ... recording_ch4.wav
+
+Samples of all streams are written as frames (one sample per stream) and interleaved in the blocks.
+*/
+class WavRecorder
+{
+public:
+    static const int block_frames = 4096;
+    static const int block_count = 32; // At most 32 * 4096 frames (~2.7 s at 48 kHz) wait for the writer.
+    static const int stem_count = 5; // Mix and 4 channels.
+private:
+    struct Block
+    {
+        std::vector<int16_t> samples;
+        int frames = 0;
+    };
+    struct Command
+    {
+        enum Type { START, WRITE, STOP } type;
+        Block* block = nullptr;
+        std::string path;
+        int sample_rate = 0;
+        int streams = 0;
+    };
+
+    std::vector<Block> blocks; // Allocated by start().
+    std::vector<Block*> free_blocks;
+    std::deque<Command> commands;
+    std::mutex queue_mutex; // Protects free_blocks and commands. Only held to take or hand over a block.
+    std::condition_variable queue_condition;
+
+    // Producer side.
+    bool recording = false;
+    int streams = 1;
+    Block* current_block = nullptr;
+    std::atomic<uint64_t> dropped_frames = 0;
+
+    std::thread thread; // Runs from start() until the STOP command was handled.
+public:
+    ~WavRecorder();
+
+    /*
+    Starts a new recording. Allocates the block pool and starts the writer thread, which creates the files.
+    @param p_stems Whether to write one file per stem (stem_count streams) instead of only the mix.
+    @return false if a recording is already running.
+    */
+    bool start(const std::string& p_path, int p_sample_rate, bool p_stems);
+    // Ends the recording. The writer thread finishes the files in the background.
+    void stop();
+
+    // Adds one frame, holding one sample for each stream of the recording.
+    void write(const int16_t* p_frame);
+
+    bool isRecording() const;
+    int getStreamCount() const;
+    uint64_t getDroppedFrames() const;
+private:
+    void pushCommand(const Command& p_command);
+    void worker();
+};
@@ -1,5 +1,8 @@
 #include "emulator.hpp"
 #include "ui.hpp"
+#if EMULGATOR_SFML_AUDIO
+#include "sfml_audio_sink.hpp"
+#endif
 #include <SFML/Graphics.hpp>
 
 #include <iostream>
@@ -48,6 +51,9 @@ int main()
     try
     {
         Emulator emulator(mutex);
+        #if EMULGATOR_SFML_AUDIO
+        emulator.setAudioSink(std::make_unique<SFMLAudioSink>());
+        #endif
         Debugger debugger(canvas, emulator, mutex);
 
         while(window.isOpen())
@@ -65,7 +71,6 @@ int main()
 
             window.clear(sf::Color(240, 240, 240));
 
-            emulator.processScreenBuffers();
             canvas.updateAllLogic();
             debugger.updateLogic();
             canvas.drawAll();
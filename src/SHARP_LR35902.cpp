@@ -69,6 +69,8 @@ void SHARP_LR35902::setFlagBit(Flags p_mask, bool p_state)
 uint8_t SHARP_LR35902::nextInstruction() 
 {
     current_cycle_count = 0;
+    uint16_t instruction_address = pc;
+    bool prefixed = false;
 
     opcode = memory.read(pc);
     pc++;
@@ -76,6 +78,7 @@ uint8_t SHARP_LR35902::nextInstruction()
     if(opcode == 0xcb)
     {
         // Execute opcode prefixed with 0xcb.
+        prefixed = true;
         opcode = memory.read(pc);
         pc++;
         (this->*prefix_instruction_table[opcode].func)();
@@ -118,6 +121,18 @@ uint8_t SHARP_LR35902::nextInstruction()
         if((opcode == 0x38) && getFlagBit(Flags::Carry)) current_cycle_count += 4;
     }
 
+    if constexpr(debug_probes_enabled)
+    {
+        if(probe_enabled)
+        {
+            probe.address = instruction_address;
+            probe.opcode = opcode;
+            probe.prefixed = prefixed;
+            probe.cycles = current_cycle_count;
+            probe.instruction_count++;
+        }
+    }
+
     return current_cycle_count;
 }
 
@@ -1,12 +1,61 @@
 #include "apu.hpp"
+#include "timing.hpp"
 
 #include <cmath>
 #include <bitset>
+#include <algorithm>
 
-APU::APU(Memory& p_memory, std::mutex& p_mutex) 
-    : mutex(p_mutex),
-    out("sound_out.bin", std::ios::out | std::ios::binary),
-    memory(p_memory)
+namespace
+{
+    /*
+    The noise channel's LFSR always starts at 0 and only depends on its own state, so its whole sequence can be computed once. The 15 bit 
+    LFSR repeats after 32767 clocks, the 7 bit one after 127. The state after n clocks since the trigger is the entry at phase n.
+    The inverse tables give the phase of a state, so switching the width can continue from the current state without searching. The 
+    only state missing in each sequence (all bits set) locks the LFSR up, it maps to phase 0.
+    */
+    struct LFSRTables
+    {
+        std::array<uint16_t, 32767> states_15;
+        std::array<uint8_t, 127> states_7;
+        std::array<uint16_t, 32768> phases_15 = {};
+        std::array<uint8_t, 128> phases_7 = {};
+
+        LFSRTables()
+        {
+            uint16_t lfsr = 0;
+            for (int i = 0; i < 32767; i++)
+            {
+                states_15[i] = lfsr;
+                int new_bit = ~(lfsr ^ (lfsr >> 1)) & 1;
+                lfsr = (lfsr >> 1) | (new_bit << 14);
+            }
+            lfsr = 0;
+            for (int i = 0; i < 127; i++)
+            {
+                states_7[i] = lfsr;
+                int new_bit = ~(lfsr ^ (lfsr >> 1)) & 1;
+                lfsr = (lfsr >> 1) | (new_bit << 6);
+            }
+
+            for (int i = 0; i < 32767; i++)
+            {
+                phases_15[states_15[i]] = i;
+            }
+            for (int i = 0; i < 127; i++)
+            {
+                phases_7[states_7[i]] = i;
+            }
+        }
+    };
+    const LFSRTables lfsr_tables;
+}
+
+APU::APU(Memory& p_memory, Timer& p_timer) 
+    : memory(p_memory),
+    timer(p_timer),
+    sink(std::make_unique<NullAudioSink>()),
+    blip(cpu_frequency, sample_rate, 1024),
+    stem_blips(4, blip)
 {
     duty_cycles[0][0] = 0; duty_cycles[1][0] = 1; duty_cycles[2][0] = 1; duty_cycles[3][0] = 0;
     duty_cycles[0][1] = 1; duty_cycles[1][1] = 1; duty_cycles[2][1] = 1; duty_cycles[3][1] = 0;
@@ -17,36 +66,11 @@ APU::APU(Memory& p_memory, std::mutex& p_mutex)
     duty_cycles[0][6] = 0; duty_cycles[1][6] = 0; duty_cycles[2][6] = 0; duty_cycles[3][6] = 1;
     duty_cycles[0][7] = 0; duty_cycles[1][7] = 0; duty_cycles[2][7] = 0; duty_cycles[3][7] = 1;
 
-    initialize(1, sample_rate);
 }
 
 APU::~APU() 
 { 
-    out.close(); 
-    stop();
-}
-
-bool APU::onGetData(Chunk& data)
-{
-    mutex.lock();
-
-    // Run update as long as it takes to generate 1024 new samples.
-    for (int i = 0; i < (cpu_frequency/sample_rate) * 1024; i++)
-    {
-        update();
-    }
-    
-    data.sampleCount = 1024;
-    data.samples = samples;
-
-    mutex.unlock();
-
-    return true;
-}
-
-void APU::onSeek(sf::Time timeOffset) 
-{
-    // Cannot be implemented.
+    sink->stop();
 }
 
 // Called by memory when a channel is triggered. Triggering a channel activates it and refreshes certain registers.
@@ -89,25 +113,84 @@ void APU::trigger(int p_channel)
         ch4_active = true;
         ch4_length_timer = memory.read(0xff20) & 0b111111;
         ch4_volume = memory.read(0xff21) >> 4;
+        ch4_direction = (memory.read(0xff21) >> 3) & 1;
+        ch4_initial_sweep_pace = memory.read(0xff21) & 0b111;
         memory.write(0xff26, memory.read(0xff26) | 0b1000);
 
-        lfsr = 0;
+        ch4_phase = 0;
     }
 }
 
-// 1 update = 1 dot
-void APU::update() 
+void APU::update(int p_cycles) 
 {
-    // Count cylces per second.
-    cycle_counter++;
-    auto now = std::chrono::high_resolution_clock::now();
-    if(std::chrono::duration_cast<std::chrono::milliseconds>(now - cycles_per_second_timer).count() >= 1000)
+    // Count cylces per second. The clock is only looked at every 4096 dots.
+    cycle_counter += p_cycles;
+    if(cycle_counter >= next_clock_check)
+    {
+        next_clock_check = cycle_counter + 4096;
+        auto now = std::chrono::high_resolution_clock::now();
+        if(std::chrono::duration_cast<std::chrono::milliseconds>(now - cycles_per_second_timer).count() >= 1000)
+        {
+            cycle_count_per_second = cycle_counter;
+            cycle_counter = 0;
+            next_clock_check = 4096;
+            cycles_per_second_timer = std::chrono::high_resolution_clock::now();
+        }
+    }
+
+    // Registers can only have been written by the last instruction, which happened right at the start of these dots.
+    for (int channel = 1; channel <= 4; channel++)
     {
-        cycle_count_per_second = cycle_counter;
-        cycle_counter = 0;
-        cycles_per_second_timer = std::chrono::high_resolution_clock::now();
+        updateAmplitude(channel, frame_clock);
     }
+    sample_creation_cycles += p_cycles * sample_rate;
 
+    /*
+    The frame sequencer steps on the falling edge of bit 4 of DIV (bit 12 of the internal counter), so every 8192 dots when the counter
+    passes a multiple of 0x2000. The timer has already run these dots, so the counter at their start tells when the next step happens.
+    Channels are run up to that step, since it changes volumes and can disable channels.
+    */
+    uint16_t start_counter = timer.internal_counter - p_cycles;
+    int frame_sequencer_timer = 0x2000 - (start_counter & 0x1fff);
+    while(p_cycles > 0)
+    {
+        int span = std::min(p_cycles, frame_sequencer_timer);
+        runChannels(span);
+        frame_clock += span;
+        p_cycles -= span;
+
+        frame_sequencer_timer -= span;
+        if(frame_sequencer_timer == 0)
+        {
+            stepFrameSequencer();
+            frame_sequencer_timer = 0x2000;
+        }
+    }
+
+    // The scopes only show the shape of the waves, so they are point-sampled. Counted in dots * sample_rate, so the 87.38 dots per sample
+    // don't get truncated.
+    if(sample_creation_cycles >= cpu_frequency)
+    {
+        if(scope_enabled)
+        {
+            for (int channel = 0; channel < 4; channel++)
+            {
+                scope_samples[channel][scope_position] = channel_amplitudes[channel];
+            }
+            scope_position = (scope_position + 1) % scope_size;
+        }
+
+        sample_creation_cycles -= cpu_frequency;
+    }
+
+    if(frame_clock >= frame_length)
+    {
+        endFrame();
+    }
+}
+
+void APU::runChannels(int p_cycles)
+{
     /*
     SOUND CHANNEL 1/2
     
@@ -119,148 +202,398 @@ void APU::update()
     of a digital wave. Their ratio  (always regarding the time the wave is high) is the duty cycle. 
     For the gameboy this waveform can be described with 8 numbers since the duty cycle can be 12.5%, 25%, 50% or  
     75%. The dutypointer is the index into where we are in this waveform/duty cycle. Like said, the duty pointer is 
-    incremented everytime duration hits 2048 and a new sample is created. We look up the current duty cycle and the 
-    duty pointer, getting a value of 0 or 1, amplifying that by multiplying some volume and finally saving it so 
-    that the sample can be played back.
+    incremented everytime duration hits 2048.
+    Instead of counting every dot, the timers hold the dots left until the next step ((2048 - duration) * 4 dots).
+    Only the steps themselves are processed and the change of the output is handed to the band-limited buffer at 
+    the exact dot of the step.
     */
 
-    ch1_duty_cycle = memory.read(0xff11) >> 6;
-    ch2_duty_cycle = memory.read(0xff16) >> 6;
-
-    if(cycles % 4 == 0)
+    ch1_timer -= p_cycles;
+    while(ch1_timer <= 0)
     {
-        if(ch1_duration >= 2048)
-        {
-            ch1_duty_pointer++;
-            if(ch1_duty_pointer >= 8)
-                ch1_duty_pointer = 0;
-
-            ch1_duration = (memory.read(0xff14) & 0b111) << 8 | memory.read(0xff13);
-        }
-        ch1_duration++;
-
-        if(ch2_duration >= 2048)
-        {
-            ch2_duty_pointer++;
-            if(ch2_duty_pointer >= 8)
-                ch2_duty_pointer = 0;
+        ch1_duty_pointer = (ch1_duty_pointer + 1) % 8;
+        updateAmplitude(1, frame_clock + p_cycles + ch1_timer);
+        ch1_timer += (2048 - ch1_duration) * 4;
+    }
 
-            ch2_duration = (memory.read(0xff19) & 0b111) << 8 | memory.read(0xff18);
-        }
-        ch2_duration++;
+    ch2_timer -= p_cycles;
+    while(ch2_timer <= 0)
+    {
+        ch2_duty_pointer = (ch2_duty_pointer + 1) % 8;
+        updateAmplitude(2, frame_clock + p_cycles + ch2_timer);
+        ch2_timer += (2048 - ch2_duration) * 4;
     }
 
     /*
     SOUND CHANNEL 3
+
+    Same as channel 1/2, but the counter is incremented every 2 dots and each step plays the next of the 32 samples in wave RAM.
     */
 
-    if(cycles % 2 == 0)
+    ch3_timer -= p_cycles;
+    while(ch3_timer <= 0)
     {
-        if(ch3_duration >= 2048)
-        {
-            ch3_sample_index++;
-            if(ch3_sample_index >= 32) ch3_sample_index = 0;
+        ch3_sample_index++;
+        if(ch3_sample_index >= 32) ch3_sample_index = 0;
 
-            int wave_byte = memory.read(0xff30 + (ch3_sample_index / 2));
-            ch3_current_sample = (wave_byte % 2 == 0) ? wave_byte >> 4 : wave_byte & 0b1111;
+        int wave_byte = memory.read(0xff30 + (ch3_sample_index / 2));
+        ch3_current_sample = (ch3_sample_index % 2 == 0) ? wave_byte >> 4 : wave_byte & 0b1111;
 
-            ch3_duration = (memory.read(0xff1e) & 0b111) << 8 | memory.read(0xff1d);
-        }
-        ch3_duration++;
+        updateAmplitude(3, frame_clock + p_cycles + ch3_timer);
+        ch3_timer += (2048 - ch3_duration) * 2;
     }
 
     /*
     SOUND CHANNEL 4
     */
 
-    int clock_shift = memory.read(0xff22) >> 4;
-    int clock_divider = memory.read(0xff22) & 0b111;
-    ch4_frequency_timer = 16.f * (clock_divider == 0 ? 0.5f : clock_divider) * std::pow(2, clock_shift);
+    ch4_timer -= p_cycles;
+    if(ch4_timer <= 0 && (!ch4_active || ch4_volume == 0))
+    {
+        // The channel is silent, so all clocks within these dots can be skipped at once.
+        int clocks = 1 + (-ch4_timer) / ch4_frequency_timer;
+        clockLFSR(clocks);
+        ch4_timer += clocks * ch4_frequency_timer;
+    }
+    while(ch4_timer <= 0)
+    {
+        clockLFSR(1);
+        updateAmplitude(4, frame_clock + p_cycles + ch4_timer);
+        ch4_timer += ch4_frequency_timer;
+    }
+}
+
+void APU::clockLFSR(int p_clocks)
+{
+    // The output is the lowest bit of the state before the last clock.
+    if(ch4_lfsr_width)
+    {
+        ch4_phase = (ch4_phase + p_clocks) % 127;
+        ch4_out = lfsr_tables.states_7[(ch4_phase + 126) % 127] & 1;
+    }
+    else
+    {
+        ch4_phase = (ch4_phase + p_clocks) % 32767;
+        ch4_out = lfsr_tables.states_15[(ch4_phase + 32766) % 32767] & 1;
+    }
+}
+
+uint16_t APU::getLFSR() const
+{
+    return ch4_lfsr_width ? lfsr_tables.states_7[ch4_phase] : lfsr_tables.states_15[ch4_phase];
+}
+
+void APU::stepFrameSequencer()
+{
+    // APU counter is incremented at a rate of 512 Hz.
+    div_apu++;
+
+    lengthTimer();
+    volumeChange();
+    durationChange();
+
+    if(div_apu >= 8)
+    {
+        div_apu = 0;
+    }
 
-    ch4_frequency_counter++;
-    if(ch4_frequency_counter >= ch4_frequency_timer)
+    for (int channel = 1; channel <= 4; channel++)
     {
-        // Clock lfsr.
-        ch4_out = lfsr & 1;
+        updateAmplitude(channel, frame_clock);
+    }
+}
 
-        int new_bit = ~(lfsr ^ (lfsr >> 1)) & 1;
-        lfsr = (lfsr >> 1) | (new_bit << 14);
-     
-        // lfsr 7-bit mode.
-        int lfsr_width = (memory.read(0xff22) >> 3) & 1;
-        if(lfsr_width)
+void APU::onDIVReset()
+{
+    // Resetting the counter while bit 12 is set is a falling edge as well.
+    if(timer.internal_counter & 0x1000)
+    {
+        stepFrameSequencer();
+    }
+}
+
+void APU::onRegisterWrite(uint16_t p_address)
+{
+    uint8_t value = memory.read(p_address);
+    switch(p_address)
+    {
+        // NR10: Sweep.
+        case 0xff10:
+            ch1_sweep_register_pace = (value >> 4) & 0b111;
+            ch1_sweep_direction = (value >> 3) & 1;
+            ch1_sweep_slope = value & 0b111;
+            break;
+        // NR11/NR21: Duty cycle.
+        case 0xff11: ch1_duty_cycle = value >> 6; break;
+        case 0xff16: ch2_duty_cycle = value >> 6; break;
+        // NRx3/NRx4: Duration and length enable.
+        case 0xff13: ch1_duration = (ch1_duration & 0x700) | value; break;
+        case 0xff14:
+            ch1_duration = (value & 0b111) << 8 | (ch1_duration & 0xff);
+            ch1_length_enable = (value >> 6) & 1;
+            break;
+        case 0xff18: ch2_duration = (ch2_duration & 0x700) | value; break;
+        case 0xff19:
+            ch2_duration = (value & 0b111) << 8 | (ch2_duration & 0xff);
+            ch2_length_enable = (value >> 6) & 1;
+            break;
+        case 0xff1d: ch3_duration = (ch3_duration & 0x700) | value; break;
+        case 0xff1e:
+            ch3_duration = (value & 0b111) << 8 | (ch3_duration & 0xff);
+            ch3_length_enable = (value >> 6) & 1;
+            break;
+        case 0xff23: ch4_length_enable = (value >> 6) & 1; break;
+    }
+
+    if(p_address == 0xff22)
+    {
+        // NR43: LFSR clock and width.
+        int clock_shift = value >> 4;
+        int clock_divider = value & 0b111;
+        ch4_frequency_timer = (clock_divider == 0 ? 8 : 16 * clock_divider) << clock_shift;
+
+        bool lfsr_width = (value >> 3) & 1;
+        if(lfsr_width != ch4_lfsr_width)
+        {
+            // Continue from the same state in the other sequence. The 7 bit LFSR only keeps the lower 7 bits. The state 0x7f locks the 
+            // 7 bit LFSR up and is not part of its sequence, it restarts instead.
+            uint16_t lfsr = getLFSR();
+            ch4_phase = lfsr_width ? lfsr_tables.phases_7[lfsr & 0x7f] : lfsr_tables.phases_15[lfsr];
+            ch4_lfsr_width = lfsr_width;
+        }
+    }
+}
+
+void APU::updateAmplitude(int p_channel, uint32_t p_clock)
+{
+    bool active[4] = { ch1_active, ch2_active, ch3_active, ch4_active };
+    int amplitude = active[p_channel - 1] ? (10000 * (getDigitalOutput(p_channel) / 15.f)) : 0;
+    if(amplitude != channel_amplitudes[p_channel - 1])
+    {
+        if(synthesizing)
+        {
+            blip.addDelta(p_clock, amplitude - channel_amplitudes[p_channel - 1]);
+        }
+        if(recording_stems)
         {
-            lfsr &= 0b10111111; // Reset bit 7.
-            lfsr |= new_bit << 6; // Set bit 7 if new_bit is true.
+            stem_blips[p_channel - 1].addDelta(p_clock, amplitude - channel_amplitudes[p_channel - 1]);
         }
+        channel_amplitudes[p_channel - 1] = amplitude;
+    }
+}
 
-        ch4_frequency_counter = 0;
+void APU::endFrame()
+{
+    if(!synthesizing)
+    {
+        frame_clock = 0;
+        return;
     }
 
-    if(cycles >= cpu_frequency/512)
+    /*
+    Dynamic rate control. If the buffer of the sink runs low, a few more samples are made per dot (and fewer if it fills up). The fill is 
+    smoothed, since the sink empties its buffer a whole chunk at a time. The pitch changes by at most 0.5%, which can't be heard.
+    */
+    int target_fill = sink->getTargetFill();
+    if(target_fill > 0)
+    {
+        average_fill += (sink->getBufferFill() - average_fill) * 0.01;
+        rate_adjustment = std::clamp(max_rate_adjustment * (target_fill - average_fill) / target_fill, -max_rate_adjustment, max_rate_adjustment);
+    }
+    else
     {
-        // APU counter is incremented at a rate of 512 Hz.
-        div_apu++;
+        rate_adjustment = 0;
+    }
+    blip.setRates(cpu_frequency, sample_rate * (1 + rate_adjustment));
 
-        lengthTimer();
-        volumeChange();
-        durationChange();
+    blip.endFrame(frame_clock);
+    if(recording_stems)
+    {
+        for (BlipBuffer& stem_blip : stem_blips)
+        {
+            stem_blip.setRates(cpu_frequency, sample_rate * (1 + rate_adjustment));
+            stem_blip.endFrame(frame_clock);
+        }
+    }
+    frame_clock = 0;
 
-        if(div_apu >= 8)
+    int16_t frame_samples[64];
+    int16_t stem_samples[4][64];
+    int count = 0;
+    while((count = blip.readSamples(frame_samples, 64)) > 0)
+    {
+        if(recording_stems)
         {
-            div_apu = 0;
+            for (int channel = 0; channel < 4; channel++)
+            {
+                stem_blips[channel].readSamples(stem_samples[channel], count);
+            }
         }
 
-        cycles = 0;
+        sink->write(frame_samples, count);
+        if(recorder.isRecording())
+        {
+            for (int i = 0; i < count; i++)
+            {
+                int16_t frame[WavRecorder::stem_count] = { frame_samples[i] };
+                if(recording_stems)
+                {
+                    for (int channel = 0; channel < 4; channel++)
+                    {
+                        frame[channel + 1] = stem_samples[channel][i];
+                    }
+                }
+                recorder.write(frame);
+            }
+        }
     }
-    cycles++;
+}
 
-    sample_creation_cycles++;
-    // Generate a new sample at the given sample rate.
-    if(sample_creation_cycles >= cpu_frequency/sample_rate)
+void APU::updateSynthesis()
+{
+    bool consumed = sink->isConsuming() || recorder.isRecording();
+    if(consumed && !synthesizing)
     {
-        samples[sample_counter] = 0;
-        // Channel 1.
-        int ch1_sample = ch1_active ? (10000 * ((duty_cycles[ch1_duty_cycle][ch1_duty_pointer] * ch1_volume)/15.f)) : 0;
-        samples[sample_counter] += ch1_sample;
-        
-        ch1_sample_list.push_back(ch1_sample);
-        if(ch1_sample_list.size() > 3200) ch1_sample_list.erase(ch1_sample_list.begin());
-        
-        // Channel 2.
-        int ch2_sample = ch2_active ? (10000 * ((duty_cycles[ch2_duty_cycle][ch2_duty_pointer] * ch2_volume)/15.f)) : 0;
-        samples[sample_counter] += ch2_sample;
-        
-        ch2_sample_list.push_back(ch2_sample);
-        if(ch2_sample_list.size() > 3200) ch2_sample_list.erase(ch2_sample_list.begin());
-        
-        // Channel 3.
-        int ch3_sample = ch3_active ? (10000 * (ch3_current_sample / 15.f)) : 0;
-        samples[sample_counter] += ch3_sample;
+        // Nothing was handed to the buffer in the meantime. It restarts at the current channel outputs.
+        blip.clear();
+        int amplitude = 0;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            amplitude += channel_amplitudes[channel];
+        }
+        blip.addDelta(frame_clock, amplitude);
+        average_fill = 0;
+    }
+    synthesizing = consumed;
+}
 
-        ch3_sample_list.push_back(ch3_sample);
-        if(ch3_sample_list.size() > 3200) ch3_sample_list.erase(ch3_sample_list.begin());
+void APU::setSink(std::unique_ptr<AudioSink> p_sink)
+{
+    bool playing = sink->isPlaying();
+    float volume = sink->getVolume();
+    sink->stop();
 
-        // Channel 4.
-        int ch4_sample = ch4_active ? (10000.f * (ch4_out * ch4_volume)/15.f) : 0;
-        samples[sample_counter] += ch4_sample;
+    sink = std::move(p_sink);
+    sink->setVolume(volume);
+    if(playing)
+    {
+        sink->start(sample_rate);
+    }
+    updateSynthesis();
+}
 
-        ch4_sample_list.push_back(ch4_sample);
-        if(ch4_sample_list.size() > 3200) ch4_sample_list.erase(ch4_sample_list.begin());
+void APU::play()
+{
+    sink->start(sample_rate);
+}
 
-        // Output samples to a file.
-        uint8_t msb = (samples[sample_counter] & 0xff00) >> 8;
-        uint8_t lsb = samples[sample_counter] & 0xff;
-        out.put(msb);
-        out.put(lsb);
+void APU::stop()
+{
+    sink->stop();
+}
+
+bool APU::isPlaying() const
+{
+    return sink->isPlaying();
+}
+
+void APU::setVolume(float p_volume)
+{
+    sink->setVolume(p_volume);
+}
 
-        sample_counter++;
-        if(sample_counter >= 1024)
+float APU::getVolume() const
+{
+    return sink->getVolume();
+}
+
+double APU::getAudioClock() const
+{
+    return sink->getClock();
+}
+
+int APU::getBufferFill() const
+{
+    return sink->getBufferFill();
+}
+
+uint64_t APU::getUnderruns() const
+{
+    return sink->getUnderruns();
+}
+
+double APU::getLatency() const
+{
+    return sink->getLatency();
+}
+
+void APU::setBufferSize(int p_samples)
+{
+    sink->setBufferSize(p_samples);
+    average_fill = 0;
+}
+
+int APU::getBufferSize() const
+{
+    return sink->getBufferSize();
+}
+
+double APU::getRateAdjustment() const
+{
+    return rate_adjustment;
+}
+
+void APU::setQuality(BlipBuffer::Quality p_quality)
+{
+    blip.setQuality(p_quality);
+    for (BlipBuffer& stem_blip : stem_blips)
+    {
+        stem_blip.setQuality(p_quality);
+    }
+}
+
+BlipBuffer::Quality APU::getQuality() const
+{
+    return blip.getQuality();
+}
+
+bool APU::startRecording(const std::string& p_path, bool p_stems)
+{
+    if(!recorder.start(p_path, sample_rate, p_stems))
+    {
+        return false;
+    }
+    updateSynthesis();
+
+    recording_stems = p_stems;
+    if(recording_stems)
+    {
+        // The stem buffers start in step with the main buffer (same position within the sample) and at the current channel outputs.
+        for (int channel = 0; channel < 4; channel++)
         {
-            sample_counter = 0;
+            stem_blips[channel] = blip;
+            stem_blips[channel].clear();
+            stem_blips[channel].addDelta(frame_clock, channel_amplitudes[channel]);
         }
-        sample_creation_cycles = 0;
     }
+    return true;
+}
+
+void APU::stopRecording()
+{
+    recorder.stop();
+    recording_stems = false;
+    updateSynthesis();
+}
+
+bool APU::isRecording() const
+{
+    return recorder.isRecording();
+}
+
+uint64_t APU::getDroppedRecordingFrames() const
+{
+    return recorder.getDroppedFrames();
 }
 
 int APU::getDigitalOutput(int p_channel)
@@ -278,6 +611,16 @@ int APU::getDigitalOutput(int p_channel)
     }
 }
 
+void APU::getScopeSnapshot(int p_channel, int16_t* p_samples, int p_count) const
+{
+    const std::array<int16_t, scope_size>& scope = scope_samples[p_channel - 1];
+    int start = (scope_position - p_count + scope_size) % scope_size;
+    for (int i = 0; i < p_count; i++)
+    {
+        p_samples[i] = scope[(start + i) % scope_size];
+    }
+}
+
 float APU::getAnalogOutput(int p_channel)
 {
     return ((getDigitalOutput(p_channel)/15.f) * 2.f) - 1;
@@ -289,7 +632,7 @@ void APU::lengthTimer()
     if((div_apu % 2) == 0)
     {
         // Channel 1.
-        if((memory.read(0xff14) >> 6 & 1) == 1)
+        if(ch1_length_enable)
         {
             ch1_length_timer++;
             if(ch1_length_timer == 64) 
@@ -299,7 +642,7 @@ void APU::lengthTimer()
             }
         }
         // Channel 2.
-        if((memory.read(0xff19) >> 6 & 1) == 1)
+        if(ch2_length_enable)
         {
             ch2_length_timer++;
             if(ch2_length_timer == 64) 
@@ -309,7 +652,7 @@ void APU::lengthTimer()
             }
         }
         // Channel 3.
-        if((memory.read(0xff1e) >> 6 & 1) == 1)
+        if(ch3_length_enable)
         {
             ch3_length_timer++;
             if(ch3_length_timer == 64)
@@ -319,7 +662,7 @@ void APU::lengthTimer()
             }
         }
         // Channel 4.
-        if((memory.read(0xff23) >> 6 & 1) == 1)
+        if(ch4_length_enable)
         {
             ch4_length_timer++;
             if(ch4_length_timer == 64) 
@@ -365,9 +708,6 @@ void APU::volumeChange()
         }
 
         // Channel 4.
-        int ch4_direction = (memory.read(0xff21) >> 3) & 1;
-        int ch4_initial_sweep_pace = memory.read(0xff21) & 0b111;
-
         if(ch4_initial_sweep_pace > 0)
         {
             ch4_sweep_pace++;
@@ -388,17 +728,14 @@ void APU::durationChange()
     // Duration sweep is clocked at 128 Hz.
     if(div_apu == 2 || div_apu == 6)
     {
-        int ch1_sweep_direction = (memory.read(0xff10) >> 3) & 1;
-        int ch1_sweep_slope = memory.read(0xff10) & 0b111;
-
         // Only do sweep iterations/duration changes, if sweep pace is not zero.
-        if((memory.read(0xff10) >> 4) & 0b111 != 0)
+        if(ch1_sweep_register_pace != 0)
         {
             ch1_duration_sweep_pace--;
             if(ch1_duration_sweep_pace <= 0)
             {
-                int old_duration = (memory.read(0xff14) & 0b111) << 8 | memory.read(0xff13);
-                int new_duration = old_duration + (ch1_sweep_direction ? -1 : 1) * old_duration / std::pow(2, ch1_sweep_slope);
+                int old_duration = ch1_duration;
+                int new_duration = old_duration + (ch1_sweep_direction ? -1 : 1) * (old_duration >> ch1_sweep_slope);
 
                 if(new_duration > 0x7ff)
                 {
@@ -414,7 +751,7 @@ void APU::durationChange()
                     }
                 }
 
-                ch1_duration_sweep_pace = (memory.read(0xff10) >> 4) & 0b111;
+                ch1_duration_sweep_pace = ch1_sweep_register_pace;
             }
         }
     }
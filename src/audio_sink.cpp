@@ -0,0 +1,42 @@
+#include "audio_sink.hpp"
+
+WavAudioSink::WavAudioSink(const std::string& p_path)
+    : path(p_path)
+{
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    recorder.stop();
+}
+
+void WavAudioSink::start(int p_sample_rate)
+{
+    if(!recorder.isRecording())
+    {
+        recorder.start(path, p_sample_rate, false);
+    }
+    playing = true;
+}
+
+void WavAudioSink::stop()
+{
+    playing = false;
+}
+
+bool WavAudioSink::isPlaying() const
+{
+    return playing;
+}
+
+void WavAudioSink::write(const int16_t* p_samples, int p_count)
+{
+    if(!playing)
+    {
+        return;
+    }
+    for (int i = 0; i < p_count; i++)
+    {
+        recorder.write(&p_samples[i]);
+    }
+}
@@ -0,0 +1,132 @@
+#include "blip_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define BLIP_BUFFER_SSE 1
+#endif
+
+BlipBuffer::BlipBuffer(double p_clock_rate, double p_sample_rate, int p_size, Quality p_quality)
+    : buffer(p_size + max_width, 0.f)
+{
+    setRates(p_clock_rate, p_sample_rate);
+    setQuality(p_quality);
+}
+
+void BlipBuffer::setRates(double p_clock_rate, double p_sample_rate)
+{
+    factor = std::llround(p_sample_rate / p_clock_rate * 4294967296.0);
+}
+
+void BlipBuffer::setQuality(Quality p_quality)
+{
+    quality = p_quality;
+    int half_width = p_quality;
+    width = half_width * 2;
+    kernel.assign(phase_count * width, 0.f);
+
+    // Windowed sinc impulse for every phase. The cutoff is a bit below the nyquist frequency, so the transition band of the window
+    // does not alias back.
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;
+    for (int phase = 0; phase < phase_count; phase++)
+    {
+        std::vector<double> taps(width);
+        double sum = 0;
+        for (int i = 0; i < width; i++)
+        {
+            double x = i - (half_width - 1) - (double)phase / phase_count;
+            double sinc = x == 0 ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+            double window = 0.42 + 0.5 * std::cos(pi * x / half_width) + 0.08 * std::cos(2 * pi * x / half_width); // Blackman.
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // Normalize, so a step of delta integrates to delta.
+        for (int i = 0; i < width; i++)
+        {
+            kernel[phase * width + i] = taps[i] / sum;
+        }
+    }
+}
+
+BlipBuffer::Quality BlipBuffer::getQuality() const
+{
+    return quality;
+}
+
+void BlipBuffer::addDelta(uint32_t p_clock, int p_delta)
+{
+    uint64_t position = offset + p_clock * factor;
+    size_t index = position >> 32;
+    int phase = (position >> (32 - phase_bits)) & (phase_count - 1);
+    // Deltas past the end of the buffer are dropped (samples weren't read in time).
+    if(index + width > buffer.size())
+    {
+        return;
+    }
+
+    float* samples = &buffer[index];
+    const float* taps = &kernel[phase * width];
+#ifdef BLIP_BUFFER_SSE
+    __m128 delta = _mm_set1_ps(p_delta);
+    for (int i = 0; i < width; i += 4)
+    {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(samples + i), _mm_mul_ps(_mm_loadu_ps(taps + i), delta));
+        _mm_storeu_ps(samples + i, sum);
+    }
+#else
+    for (int i = 0; i < width; i++)
+    {
+        samples[i] += p_delta * taps[i];
+    }
+#endif
+}
+
+void BlipBuffer::endFrame(uint32_t p_clocks)
+{
+    offset += p_clocks * factor;
+}
+
+int BlipBuffer::getSamplesAvailable() const
+{
+    return offset >> 32;
+}
+
+int BlipBuffer::readSamples(int16_t* p_samples, int p_count)
+{
+    int count = getSamplesAvailable();
+    if(count > p_count)
+    {
+        count = p_count;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        integrator += buffer[i];
+        float sample = std::round(integrator);
+        if(sample > INT16_MAX) sample = INT16_MAX;
+        if(sample < INT16_MIN) sample = INT16_MIN;
+        p_samples[i] = sample;
+        // High-pass. Lets the output drift back to 0.
+        integrator -= integrator * (1.f / (1 << bass_shift));
+    }
+
+    // Move the remaining samples (including the tail of the last impulses) to the front.
+    int remaining = getSamplesAvailable() - count + max_width;
+    std::memmove(buffer.data(), buffer.data() + count, remaining * sizeof(float));
+    std::memset(buffer.data() + remaining, 0, count * sizeof(float));
+    offset -= (uint64_t)count << 32;
+
+    return count;
+}
+
+void BlipBuffer::clear()
+{
+    std::fill(buffer.begin(), buffer.end(), 0.f);
+    offset &= 0xffffffff;
+    integrator = 0;
+}
@@ -14,7 +14,7 @@ Emulator::Emulator(std::mutex& p_mutex)
     ppu(memory, cpu), 
     input(memory, cpu), 
     timer(memory, cpu),
-    apu(memory, mutex)
+    apu(memory, timer)
 {
     thread = std::thread(&Emulator::worker, this);
 
@@ -24,19 +24,25 @@ Emulator::Emulator(std::mutex& p_mutex)
 Emulator::~Emulator() 
 {
     std::cout << "Trying to join worker." << std::endl;
+    worker_mutex.lock();
     thread_finished = true;
+    worker_mutex.unlock();
+    worker_condition.notify_one();
     thread.join();
     std::cout << "Joined" << std::endl;
 }
 
-void Emulator::processScreenBuffers() 
+void Emulator::processScreenBuffers(bool p_background, bool p_window) 
 {
-    ppu.processScreenBuffers();
+    ppu.processScreenBuffers(p_background, p_window);
 }
 
 void Emulator::reset()
 {
+    mutex.lock();
     cpu.reset();
+    ppu.reset();
+    mutex.unlock();
 }
 
 void Emulator::loadCartridge(const std::string& p_string)
@@ -44,7 +50,13 @@ void Emulator::loadCartridge(const std::string& p_string)
     if(!enabled)
     {
         cpu.reset();
+        ppu.reset();
         memory.loadCartridge(p_string);
+
+        worker_mutex.lock();
+        cartridge_loaded = memory.isCartridgeLoaded();
+        worker_mutex.unlock();
+        worker_condition.notify_one();
     }
 }
 
@@ -61,8 +73,12 @@ void Emulator::markKeyReleased(Input::Keys key)
 void Emulator::setSpeed(int p_percentage)
 {
     frequency_percentage = p_percentage;
-    cycle_budget = 0;
-    step_duration_timer = std::chrono::high_resolution_clock::now();
+    pacing_resync = true;
+}
+
+int Emulator::getCycleBudget() const
+{
+    return reported_cycle_budget;
 }
 
 int Emulator::getSpeed()
@@ -70,6 +86,40 @@ int Emulator::getSpeed()
     return frequency_percentage;
 }
 
+void Emulator::setFrameSkip(int p_frame_skip)
+{
+    mutex.lock();
+    ppu.frame_skip = p_frame_skip;
+    mutex.unlock();
+}
+
+int Emulator::getFrameSkip()
+{
+    return ppu.frame_skip;
+}
+
+void Emulator::requestFrame()
+{
+    mutex.lock();
+    ppu.requestFrame();
+    mutex.unlock();
+}
+
+void Emulator::setOutputFormat(PPU::OutputFormat p_format)
+{
+    mutex.lock();
+    ppu.setOutputFormat(p_format);
+    mutex.unlock();
+}
+
+void Emulator::setAudioSink(std::unique_ptr<AudioSink> p_sink)
+{
+    mutex.lock();
+    apu.setSink(std::move(p_sink));
+    pacing_resync = true;
+    mutex.unlock();
+}
+
 void Emulator::setVolume(float p_volume)
 {
     apu.setVolume(p_volume);
@@ -79,6 +129,45 @@ float Emulator::getVolume()
     return apu.getVolume();
 }
 
+void Emulator::setAudioBufferSize(int p_samples)
+{
+    mutex.lock();
+    apu.setBufferSize(p_samples);
+    pacing_resync = true;
+    mutex.unlock();
+}
+
+int Emulator::getAudioBufferSize()
+{
+    return apu.getBufferSize();
+}
+
+void Emulator::setAudioQuality(BlipBuffer::Quality p_quality)
+{
+    mutex.lock();
+    apu.setQuality(p_quality);
+    mutex.unlock();
+}
+
+BlipBuffer::Quality Emulator::getAudioQuality()
+{
+    return apu.getQuality();
+}
+
+void Emulator::startRecording(const std::string& p_path, bool p_stems)
+{
+    mutex.lock();
+    apu.startRecording(p_path, p_stems);
+    mutex.unlock();
+}
+
+void Emulator::stopRecording()
+{
+    mutex.lock();
+    apu.stopRecording();
+    mutex.unlock();
+}
+
 const Memory& Emulator::getMemory()
 {
     return memory;
@@ -94,6 +183,11 @@ const PPU& Emulator::getPPU()
     return ppu;
 }
 
+const PPU::Frame& Emulator::getLatestFrame()
+{
+    return ppu.getLatestFrame();
+}
+
 const APU& Emulator::getAPU()
 {
     return apu;
@@ -101,9 +195,9 @@ const APU& Emulator::getAPU()
 
 void Emulator::setEnabled(bool p_bool) 
 {
+    worker_mutex.lock();
     enabled = p_bool;
-    step_duration_timer = std::chrono::high_resolution_clock::now();
-    cycle_budget = 0;
+    worker_mutex.unlock();
 
     if(p_bool)
     {
@@ -113,6 +207,9 @@ void Emulator::setEnabled(bool p_bool)
     {
         apu.stop();
     }
+
+    pacing_resync = true;
+    worker_condition.notify_one();
 }
 
 bool Emulator::isEnabled() const
@@ -120,11 +217,34 @@ bool Emulator::isEnabled() const
     return enabled;
 }
 
+void Emulator::attachDebugger(bool p_ppu, bool p_cpu)
+{
+    mutex.lock();
+    ppu.probe_enabled = p_ppu;
+    cpu.probe_enabled = p_cpu;
+    mutex.unlock();
+}
+
+void Emulator::enableChannelScopes(bool p_state)
+{
+    mutex.lock();
+    apu.scope_enabled = p_state;
+    mutex.unlock();
+}
+
 void Emulator::worker()
 {
     while(!thread_finished)
     {
-        if(enabled == false) continue;
+        {
+            // Nothing to run while stopped or without a cartridge, so the thread sleeps instead of spinning.
+            std::unique_lock<std::mutex> lock(worker_mutex);
+            worker_condition.wait(lock, [this](){ return thread_finished || (enabled && cartridge_loaded); });
+            if(thread_finished)
+            {
+                break;
+            }
+        }
 
         /*
         If the actual work time of the computer to execute n cycles is larger than the time we would like to execute them in, we start 'lacking behing'
@@ -134,13 +254,36 @@ void Emulator::worker()
         if work_time for n cycles > desired_time for n cycles: starts 'lacking behind' and cycle_budget increases steadily
         */
 
-        auto now = std::chrono::high_resolution_clock::now();
-        int time_passed = std::chrono::duration_cast<std::chrono::milliseconds>(now - step_duration_timer).count();
-        int cycles_to_execute = time_passed/1000.f * cpu_frequency * frequency_percentage/100.f;
+        // The sink providing the audio clock can be replaced by the UI thread, which holds the mutex while doing so.
+        mutex.lock();
+        double now = getPacingClock();
+        mutex.unlock();
+        double time_passed = now - pacing_time;
+        pacing_time = now;
+        // Switching clocks (audio starting or stopping), a changed speed or a long stall resynchronises instead of catching up.
+        if(pacing_resync.exchange(false))
+        {
+            cycle_budget = 0;
+            time_passed = 0;
+        }
+        if(time_passed < 0 || time_passed > 0.25)
+        {
+            time_passed = 0;
+        }
+        int cycles_to_execute = time_passed * cpu_frequency * frequency_percentage/100.f;
         cycle_budget += cycles_to_execute;
-        step_duration_timer = std::chrono::high_resolution_clock::now();
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Sleep shortly so that time_passed has a meaningful value (and not just 0 since barely any time passed).
+        {
+            // Sleep until the next slot so that time_passed has a meaningful value (and not just 0 since barely any time passed). Stopping 
+            // the emulator wakes the thread up early.
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+            std::unique_lock<std::mutex> lock(worker_mutex);
+            worker_condition.wait_until(lock, deadline, [this](){ return thread_finished || !enabled; });
+        }
+        if(!enabled)
+        {
+            continue;
+        }
         
         while(cycle_budget >= 0)
         {
@@ -148,6 +291,7 @@ void Emulator::worker()
             // Subtract cycle budget.
             cycle_budget -= cycles_since_last_instruction;
         }
+        reported_cycle_budget = cycle_budget;
     }
 }
 
@@ -186,12 +330,23 @@ int Emulator::step()
             executeInterrupt(CPU_INT::JOYPAD, 0x0060);
     }
 
-    // LCD and TIMER.
-    for (uint8_t i = 0; i < cycles_since_last_instruction; i++)
+    // LCD, TIMER and APU. The PPU is skipped entirely while the LCD is off (only the CPU can switch it on).
+    if(ppu.getLCDCBit(PPU::LCD_AND_PPU_ENABLE))
+    {
+        for (uint8_t i = 0; i < cycles_since_last_instruction; i++)
+        {
+            ppu.update();
+            timer.update();
+        }
+    }
+    else
     {
-        ppu.update();
-        timer.update();
+        for (uint8_t i = 0; i < cycles_since_last_instruction; i++)
+        {
+            timer.update();
+        }
     }
+    apu.update(cycles_since_last_instruction);
     
     // INPUT.
     input.update();
@@ -201,6 +356,16 @@ int Emulator::step()
     return cycles_since_last_instruction;
 }
 
+double Emulator::getPacingClock()
+{
+    double audio_clock = apu.getAudioClock();
+    if(audio_clock >= 0)
+    {
+        return audio_clock;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void Emulator::executeInterrupt(SHARP_LR35902::Interrupt p_type, uint16_t address) 
 {
     // Disable interrupts so we do not get interrupted while executing the interrupt. The IE register is never reset by hardware.
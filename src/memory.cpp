@@ -267,10 +267,10 @@ uint8_t Memory::read(uint16_t p_address, bool restricted) const
 {
     if(restricted) 
     {
-        if(internal_memory[0xff40] & 0b10000000) // Check if LCD is on.
+        if(ppu.getLCDCBit(PPU::LCD_AND_PPU_ENABLE)) // Check if LCD is on.
         {
             // Make VRAM and OAM RAM inaccessible during certain PPU modes.
-            uint8_t ppu_mode = internal_memory[0xff41] & 0b00000011;
+            uint8_t ppu_mode = ppu.getLCDMode();
             if((p_address >= 0x8000) && (p_address <= 0x9fff)) // Address is in VRAM area.
             {
                 if(ppu_mode == 3)
@@ -288,6 +288,12 @@ uint8_t Memory::read(uint16_t p_address, bool restricted) const
         }
     }
 
+    // LCD registers are owned by the PPU.
+    if(PPU::isRegister(p_address))
+    {
+        return ppu.readRegister(p_address);
+    }
+
     // Read using memory bank controllers if they exist.
     if(cartridge.type_code == 0)
     {
@@ -319,10 +325,10 @@ void Memory::write(uint16_t p_address, uint8_t p_value, bool restricted)
 {
     if(restricted) 
     {
-        if(internal_memory[0xff40] & 0b10000000) // Check if LCD is on.
+        if(ppu.getLCDCBit(PPU::LCD_AND_PPU_ENABLE)) // Check if LCD is on.
         {
             // Make VRAM and OAM RAM read-only during certain PPU modes.
-            uint8_t ppu_mode = internal_memory[0xff41] & 0b00000011;
+            uint8_t ppu_mode = ppu.getLCDMode();
             if((p_address >= 0x8000) && (p_address <= 0x9fff)) // Address is in VRAM area.
             {
                 if(ppu_mode == 3)
@@ -342,7 +348,7 @@ void Memory::write(uint16_t p_address, uint8_t p_value, bool restricted)
         // Make lower 3 bits of STAT register read-only.
         if(p_address == 0xff41)
         {
-            internal_memory[0xff41] = (p_value & 0b11111000) | (internal_memory[p_address] & 0b00000111);
+            ppu.writeRegister(0xff41, (p_value & 0b11111000) | (ppu.readRegister(0xff41) & 0b00000111));
             return;
         }
 
@@ -390,11 +396,30 @@ void Memory::write(uint16_t p_address, uint8_t p_value, bool restricted)
             {
                 internal_memory[0xff05] += 1;
             }
+            apu.onDIVReset();
             timer.internal_counter = 0;
             return;
         }
     }
 
+    // Registers read by the PPU while drawing (LCDC, BGP, OBP0, OBP1, WX). Writes during mode 3 are logged with the current PPU cycle.
+    if(p_address == 0xff40 || (p_address >= 0xff47 && p_address <= 0xff49) || p_address == 0xff4b)
+    {
+        ppu.onRegisterWrite(p_address, p_value);
+        if(ppu.getLCDMode() == PPU::DRAWING_PIXELS && register_write_count < register_write_capacity)
+        {
+            register_writes[register_write_count] = { ppu.getCycleCount(), p_address, p_value };
+            register_write_count++;
+        }
+    }
+
+    // LCD registers are owned by the PPU.
+    if(PPU::isRegister(p_address))
+    {
+        ppu.writeRegister(p_address, p_value);
+        return;
+    }
+
     // Write using memory bank controllers if they exist.
     if(cartridge.type_code == 0)
     {
@@ -419,6 +444,22 @@ void Memory::write(uint16_t p_address, uint8_t p_value, bool restricted)
         }
     }
     
+    // Tile data and tile maps.
+    if(p_address >= 0x8000 && p_address <= 0x9fff)
+    {
+        ppu.onVRAMWrite(p_address);
+    }
+    if(p_address >= 0xfe00 && p_address <= 0xfe9f)
+    {
+        ppu.onOAMWrite(p_address);
+    }
+
+    // Sound registers.
+    if(p_address >= 0xff10 && p_address <= 0xff26)
+    {
+        apu.onRegisterWrite(p_address);
+    }
+
     // Sound channel triggering.
     if(p_address == 0xff14 && (p_value >> 7) == 1)
     {
@@ -445,6 +486,10 @@ void Memory::write(uint16_t p_address, uint8_t p_value, bool restricted)
         {
             internal_memory[0xfe00 + i] = read(start_address + i);
         }
+        for (uint16_t i = 0; i <= 0x009f; i += 4)
+        {
+            ppu.onOAMWrite(0xfe00 + i);
+        }
     }
 }
 
@@ -477,6 +522,7 @@ void Memory::loadCartridge(const std::string& p_file_path)
     {
         mbc1.reset(p_file_path);
     }
+    cartridge_loaded = true;
 }
 
 const Memory::Cartridge& Memory::getCartridge() const
@@ -484,6 +530,26 @@ const Memory::Cartridge& Memory::getCartridge() const
     return cartridge;
 }
 
+bool Memory::isCartridgeLoaded() const
+{
+    return cartridge_loaded;
+}
+
+int Memory::getRegisterWriteCount() const
+{
+    return register_write_count;
+}
+
+const Memory::RegisterWrite& Memory::getRegisterWrite(int p_index) const
+{
+    return register_writes[p_index];
+}
+
+void Memory::clearRegisterWrites()
+{
+    register_write_count = 0;
+}
+
 void Memory::loadHeader(const std::string& p_file_path)
 {
     std::ifstream stream(p_file_path, std::ios::in | std::ios::binary | std::ios::ate);
@@ -1,5 +1,8 @@
 #include "ppu.hpp"
+#include "tile_decoder.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 // void DisplayData::drawSpritesToBuffer(std::vector<uint8_t>& buffer) 
 // {
@@ -94,11 +97,14 @@
 // }
 
 PPU::PPU(Memory& p_memory, SHARP_LR35902& p_cpu) 
-    : memory(p_memory), cpu(p_cpu),
-    screen_buffer(screen_width * screen_height),
-    background_buffer(actual_screen_width * actual_screen_height),
-    window_buffer(actual_screen_width * actual_screen_height)
+    : memory(p_memory), cpu(p_cpu)
 {
+    background_view.pixels.resize(actual_screen_width * actual_screen_height);
+    window_view.pixels.resize(actual_screen_width * actual_screen_height);
+    screen_buffer = frames.getBackBuffer().data();
+    dirty_tile_rows.fill(true);
+    objects.fill({});
+
     // RGBA Colors: Day & Night Color Scheme.
     color_palette[3] = 0x011a27ff;
     color_palette[2] = 0x063852ff;
@@ -123,54 +129,122 @@ PPU::PPU(Memory& p_memory, SHARP_LR35902& p_cpu)
     // color_palette[1] = 0x9f9f9fff;
     // color_palette[0] = 0xdfdfdfff; // Light.
 
+    // Store the palette colors (0xRRGGBBAA) with their bytes in the order a texture expects, independent of the byte order of the machine.
+    for (size_t i = 0; i < color_palette.size(); i++)
+    {
+        uint8_t bytes[4] = { (uint8_t)(color_palette[i] >> 24), (uint8_t)(color_palette[i] >> 16), (uint8_t)(color_palette[i] >> 8), (uint8_t)color_palette[i] };
+        std::memcpy(&rgba_palette[i], bytes, 4);
+    }
+
+    reset();
+}
+
+void PPU::reset()
+{
+    // Games start right after the boot ROM, which turned the LCD on. Many wait for VBLANK before they write LCDC themselves.
+    lcdc_register = 0x91;
+    stat_register = 0x80;
+    scroll_y_register = 0x00;
+    scroll_x_register = 0x00;
+    lyc_register = 0x00;
+    bgp_register = 0xfc;
+    obp0_register = 0xff;
+    obp1_register = 0xff;
+    window_y_register = 0x00;
+    window_x_register = 0x00;
+    switchLCD(true);
 }
 
 void PPU::setLCDCBit(LCDC mask, bool p_state) 
 {
-    uint8_t byte = memory.read(0xff40);
     if(p_state == true)
     {
-        byte |= mask;
+        lcdc_register |= mask;
     }
     else
     {
-        byte &= ~mask;
+        lcdc_register &= ~mask;
     }
-    memory.write(0xff40, byte);
 }
 
 bool PPU::getLCDCBit(LCDC mask) const
 {
-    return mask & memory.read(0xff40);
+    return mask & lcdc_register;
 }
 
 void PPU::setSTATBit(STAT mask, bool p_state) 
 {
-    uint8_t byte = memory.read(0xff41);
     if(p_state == true)
     {
-        byte |= mask;
+        stat_register |= mask;
     }
     else
     {
-        byte &= ~mask;
+        stat_register &= ~mask;
     }
-    memory.write(0xff41, byte);    
 }
 
 void PPU::setLCDMode(LCDMODE state) 
 {
-    memory.write(0xff41, (memory.read(0xff41) >> 2) << 2 | state, false);
+    stat_register = (stat_register >> 2) << 2 | state;
 }
 
 PPU::LCDMODE PPU::getLCDMode() const
 {
-    return (LCDMODE)(memory.read(0xff41) & 0b00000011);
+    return (LCDMODE)(stat_register & 0b00000011);
 }
 
 bool PPU::getSTATBit(STAT mask) const
 {
-    return mask & memory.read(0xff41);    
+    return mask & stat_register;
+}
+
+bool PPU::isRegister(uint16_t p_address)
+{
+    return p_address >= 0xff40 && p_address <= 0xff4b && p_address != 0xff46;
+}
+
+uint8_t PPU::readRegister(uint16_t p_address) const
+{
+    switch(p_address)
+    {
+        case 0xff40: return lcdc_register;
+        case 0xff41: return stat_register;
+        case 0xff42: return scroll_y_register;
+        case 0xff43: return scroll_x_register;
+        case 0xff44: return ly_register;
+        case 0xff45: return lyc_register;
+        case 0xff47: return bgp_register;
+        case 0xff48: return obp0_register;
+        case 0xff49: return obp1_register;
+        case 0xff4a: return window_y_register;
+        case 0xff4b: return window_x_register;
+    }
+    return 0xff;
+}
+
+void PPU::writeRegister(uint16_t p_address, uint8_t p_value)
+{
+    switch(p_address)
+    {
+        case 0xff40:
+        {
+            bool lcd_switched = (lcdc_register ^ p_value) & LCDC::LCD_AND_PPU_ENABLE;
+            lcdc_register = p_value;
+            if(lcd_switched) switchLCD(p_value & LCDC::LCD_AND_PPU_ENABLE);
+            break;
+        }
+        case 0xff41: stat_register = p_value; break;
+        case 0xff42: scroll_y_register = p_value; break;
+        case 0xff43: scroll_x_register = p_value; break;
+        case 0xff44: ly_register = p_value; break;
+        case 0xff45: lyc_register = p_value; break;
+        case 0xff47: bgp_register = p_value; break;
+        case 0xff48: obp0_register = p_value; break;
+        case 0xff49: obp1_register = p_value; break;
+        case 0xff4a: window_y_register = p_value; break;
+        case 0xff4b: window_x_register = p_value; break;
+    }
 }
 
 const std::array<uint32_t, 4>& PPU::getColorPalette() const
@@ -178,15 +252,72 @@ const std::array<uint32_t, 4>& PPU::getColorPalette() const
     return color_palette;
 }
 
+void PPU::setOutputFormat(OutputFormat p_format)
+{
+    output_format = p_format;
+    if(output_format == RGBA8888)
+    {
+        output_palette = rgba_palette;
+    }
+    else
+    {
+        output_palette = { 0, 1, 2, 3 };
+    }
+}
+
+PPU::OutputFormat PPU::getOutputFormat() const
+{
+    return output_format;
+}
+
 uint32_t PPU::getCycleCount() const
 {
     return cycles;
 }
 
-void PPU::processScreenBuffers() 
+void PPU::switchLCD(bool p_on)
+{
+    // While the LCD is off, LY stays 0 and the PPU stays in mode 0. Turning it on starts a new frame at line 0.
+    cycles = 0;
+    ly_register = 0;
+    setLCDMode(HBLANK);
+    setSTATBit(LY_EQUALS_LYC, lyc_register == ly_register);
+
+    fifo.clear();
+    output_x = -8;
+    output_y = 0;
+    fetcher_x = 0;
+    fetcher_y = 0;
+    fetcher_cycles = 0;
+    window_on_scanline = false;
+    window_triggered = false;
+    window_internal_counter = 0;
+    scanline_in_bulk = false;
+
+    // The LCD shows a blank screen while it is off.
+    if(!p_on)
+    {
+        std::fill(screen_buffer, screen_buffer + 160 * 144, output_palette[0]);
+        frames.publish();
+        screen_buffer = frames.getBackBuffer().data();
+    }
+}
+
+const PPU::Frame& PPU::getLatestFrame()
 {
-    writeTileMapToBuffer(getLCDCBit(LCDC::BG_TILE_MAP), getLCDCBit(LCDC::BG_AND_WIN_TILE_DATA), background_buffer, actual_screen_width, actual_screen_height);
-    writeTileMapToBuffer(getLCDCBit(LCDC::WINDOW_TILE_MAP), getLCDCBit(LCDC::BG_AND_WIN_TILE_DATA), window_buffer, actual_screen_width, actual_screen_height);
+    return frames.getFrontBuffer();
+}
+
+void PPU::processScreenBuffers(bool p_background, bool p_window) 
+{
+    if(p_background)
+    {
+        updateTileMapView(background_view, getLCDCBit(LCDC::BG_TILE_MAP), getLCDCBit(LCDC::BG_AND_WIN_TILE_DATA));
+    }
+    if(p_window)
+    {
+        updateTileMapView(window_view, getLCDCBit(LCDC::WINDOW_TILE_MAP), getLCDCBit(LCDC::BG_AND_WIN_TILE_DATA));
+    }
 }
 
 void PPU::update() 
@@ -211,10 +342,18 @@ void PPU::update()
     - Object enable
     - Objects with positions 0-8
     - Window
+    - Scanline renderer: Scanlines are drawn at once at the end of mode 3. Register writes during mode 3 are replayed from the register write log, 
+      the FIFO only draws scanlines on which the window start changes (WX, window enable).
+    - LCD off: Nothing happens while the LCD is off (LY = 0, mode 0).
     */
 
+    if(!getLCDCBit(LCDC::LCD_AND_PPU_ENABLE))
+    {
+        return;
+    }
+
     // PPU Modes.
-    if(memory.read(0xff44) >= 144) 
+    if(ly_register >= 144) 
     {
         setLCDMode(VBLANK);
         fetcher_y = 0;
@@ -227,31 +366,31 @@ void PPU::update()
         {
             setLCDMode(OAMSCAN);
             
-            // Find all objects on the current scanline.
-            writeOAMToBuffer();
-            objects_on_scanline.clear();
-            for (int i = 0; i < objects.size(); i++)
+            // Decide at the start of each frame whether it is drawn.
+            if(ly_register == 0)
             {
-                int actual_object_height = objects[i].y - 16;
-                if(actual_object_height >= fetcher_y - (getLCDCBit(LCDC::OBJECT_SIZE) ? 15 : 7) && actual_object_height <= fetcher_y)
-                {
-                    objects_on_scanline.push_back(objects[i]);
-                    if(objects_on_scanline.size() == 10) break;
-                }
+                startFrame();
+            }
+
+            // Find all objects on the current scanline. Skipped frames don't need them.
+            object_count = 0;
+            if(drawing_frame)
+            {
+                findObjects();
             }
             
             // Read how much the screen is scrolled at the start of each scanline.
-            scroll_x = memory.read(0xff43);
-            scroll_y = memory.read(0xff42);
+            scroll_x = scroll_x_register;
+            scroll_y = scroll_y_register;
 
             // Read window position (maybe the ppu actually reads those registers somewhere else?).
-            window_x = memory.read(0xff4b);
-            window_y = memory.read(0xff4a);
+            window_x = window_x_register;
+            window_y = window_y_register;
 
             if(window_triggered) window_internal_counter++;
             window_triggered = false;
 
-            if(memory.read(0xff44) == memory.read(0xff4a)) // LY = WY.
+            if(ly_register == window_y_register) // LY = WY.
             {
                 window_on_scanline = true; 
                 window_internal_counter = 0;
@@ -264,87 +403,52 @@ void PPU::update()
             // Push 8 empty pixels to the fifo at the start of each line. Prefechting this empty tile is necessary due to objects that might be positioned at 0-8 (-8 to -1 in screen coordinates).
             for (int i = 0; i < 8; i++)
             {
-                fifo.push_back({});
+                fifo.push({});
+            }
+
+            // Remember the registers at the start of mode 3. Together with the register writes logged by memory during mode 3, this
+            // gives the register values at every dot of the scanline.
+            for (size_t i = 0; i < drawing_registers.size(); i++)
+            {
+                drawing_registers[i] = readRegister(0xff40 + i);
             }
+            memory.clearRegisterWrites();
+
+            if(drawing_frame)
+            {
+                composeObjectLayer(-8);
+            }
+
+            // The whole scanline is drawn at once when mode 3 ends, unless a register write changes the timing of mode 3. Skipped frames 
+            // only wait for the end of mode 3.
+            scanline_in_bulk = scanline_renderer_enabled || !drawing_frame;
+            drawing_window_start = getWindowStart();
+            drawing_end_cycle = getOutputCycle(159);
         }
     }
     
     if(getLCDMode() == DRAWING_PIXELS)
     {
-        // Draw window.
-        if(getLCDCBit(LCDC::WINDOW_ENABLE) && window_on_scanline && !window_triggered && output_x == memory.read(0xff4b) - 7)
+        if(scanline_in_bulk)
         {
-            // Reset fetch.
-            fetcher_cycles = 0;
-            fetcher_x = memory.read(0xff4b) / 8;
-            // Clear fifo.
-            fifo.clear();
-
-            window_triggered = true;
-        }
-
-        // Fetcher. 
-        if(fetcher_cycles == 0)
-        {
-            // Another 8 pixels are pulled every 8 dots (2 dots tile read, 2 dots read tiledata low, 2 dots readtile data high, 2 dots sleep/waiting until the FIFO has only 8 pixels left). 
-            fetchTile();
-
-            // Remove front pixels at start of scanline for scrolling.
-            if(cycles == 80)
+            if(cycles == drawing_end_cycle)
             {
-                int pixels_to_erase = scroll_x % 8;
-                for (int i = 0; i < pixels_to_erase; i++)
+                if(drawing_frame)
                 {
-                    fifo.erase(fifo.begin());
+                    renderScanline();
                 }
-            }
-
-            fetcher_x++;
-            fetcher_cycles = 8;
-        }
-
-        fetcher_cycles--;
-
-        // Push to LCD if there are at least 8 pixels in the FIFO.
-        if(fifo.size() > 8)
-        {
-            // Object fetcher.
-            tryFetchingObject(output_x);
-
-            // Apply palettes.
-            uint8_t pixel_palette = 0;
-            if(fifo.front().palette == PALETTE::BGP) pixel_palette = memory.read(0xff47);
-            if(fifo.front().palette == PALETTE::OBP0) pixel_palette = memory.read(0xff48);
-            if(fifo.front().palette == PALETTE::OBP1) pixel_palette = memory.read(0xff49);
-            uint8_t palette_color = (pixel_palette >> (fifo.front().color * 2)) & 0b11;
-
-            // Push to LCD.
-            if(output_x >= 0) // The first 8 empty pixels of each scanline won't be visible and are therefore just discarded.
-            {
-                screen_buffer[output_x + output_y * 160] = palette_color;
-            }
-            fifo.erase(fifo.begin());
-
-            output_x++;
-
-            // End of drawing pixels to this scanline. Discard unnecessary data.
-            if(output_x >= 160)  
-            {
-                output_x = -8;
-                output_y++;
-                setLCDMode(HBLANK);
-
-                if(getSTATBit(STAT::HBLANK_STAT_INTERRUPT))
+                else if(drawing_window_start < 160)
                 {
-                    cpu.requestInterrupt(SHARP_LR35902::Interrupt::LCD_STAT);
+                    // Keep the window line counter running.
+                    window_triggered = true;
                 }
-
-                fifo.clear();
-                fetcher_cycles = 0;
-                fetcher_x = 0;
-                fetcher_y++;
+                endDrawing();
             }
         }
+        else
+        {
+            drawPixel(cycles);
+        }
     }
 
     // STAT Interrupts.
@@ -352,14 +456,21 @@ void PPU::update()
     {
         cpu.requestInterrupt(SHARP_LR35902::Interrupt::LCD_STAT);
     }
-    if(cycles == 0 && (memory.read(0xff44) == memory.read(0xff45)) && getSTATBit(STAT::LYC_EQUALS_LY_INTERRUPT)) // Request only at the start of each scanline.
+    if(cycles == 0 && (ly_register == lyc_register) && getSTATBit(STAT::LYC_EQUALS_LY_INTERRUPT)) // Request only at the start of each scanline.
     {
         cpu.requestInterrupt(SHARP_LR35902::Interrupt::LCD_STAT);
     }
 
     // Interrupts on entering VBLANK period.
-    if(cycles == 0 && memory.read(0xff44) == 144)
+    if(cycles == 0 && ly_register == 144)
     {
+        // The frame is complete.
+        if(drawing_frame)
+        {
+            frames.publish();
+            screen_buffer = frames.getBackBuffer().data();
+        }
+
         cpu.requestInterrupt(SHARP_LR35902::VBLANK);
 
         if(getSTATBit(STAT::VBLANK_STAT_INTERRUPT))
@@ -374,132 +485,527 @@ void PPU::update()
     if(cycles == 456)
     {
         // Increment LY or wrap it back to 0.
-        memory.write(0xff44, memory.read(0xff44) + 1, false);
-        if(memory.read(0xff44) >= 154)
+        ly_register++;
+        if(ly_register >= 154)
         {
-            memory.write(0xff44, 0, false);
+            ly_register = 0;
         }
 
         // Check if LY = LYC.
-        setSTATBit(LY_EQUALS_LYC, memory.read(0xff45) == memory.read(0xff44));
+        setSTATBit(LY_EQUALS_LYC, lyc_register == ly_register);
         
         // Reset cycles.
         cycles = 0;
     }
 }
 
-void PPU::getTile(uint16_t p_address, std::vector<uint8_t>& p_pixels) const 
+void PPU::requestFrame()
 {
-    if(p_pixels.size() != 64)
+    frame_requested = true;
+}
+
+void PPU::startFrame()
+{
+    // The first frame is drawn, then frame_skip - 1 frames are skipped. Lowering frame_skip draws the next frame right away.
+    if(frames_until_drawing >= frame_skip) frames_until_drawing = 0;
+    drawing_frame = frame_requested || (frame_skip > 0 && frames_until_drawing == 0);
+    if(drawing_frame)
     {
-        p_pixels.resize(64, 0);
+        frames_until_drawing = frame_skip;
+        frame_requested = false;
     }
-    int row = 0;
-    for (int i = 0; i < 16; i+=2)
-    {
-        uint8_t current_byte = memory.read(p_address + i, false);
-        uint8_t next_byte = memory.read(p_address + i + 1, false);
+    if(frames_until_drawing > 0) frames_until_drawing--;
+}
 
-        // Loop over each bit.
-        for(int j = 7; j >= 0; j--)
+void PPU::findObjects()
+{
+    updateObjectBuckets();
+    const ObjectBucket& bucket = object_buckets[fetcher_y % 144];
+    object_count = bucket.count;
+    for (int i = 0; i < bucket.count; i++)
+    {
+        objects_on_scanline[i] = objects[bucket.objects[i]];
+    }
+    // Objects are drawn from left to right, objects on the same x position in OAM order.
+    std::stable_sort(objects_on_scanline.begin(), objects_on_scanline.begin() + object_count, [](const Object& a, const Object& b) { return a.x < b.x; });
+    if constexpr(debug_probes_enabled)
+    {
+        if(probe_enabled)
         {
-            uint8_t msbit = (next_byte >> j) & 1;
-            uint8_t lsbit = (current_byte >> j) & 1;
-            p_pixels[row * 8 + (7 - j)] = (msbit << 1) | lsbit;
+            probe.object_count = object_count;
+            for (int i = 0; i < object_count; i++)
+            {
+                probe.object_x[i] = objects_on_scanline[i].x;
+                probe.object_y[i] = objects_on_scanline[i].y;
+            }
         }
-        row++;
     }
 }
 
-void PPU::writeTileMapToBuffer(bool p_tile_map, bool p_tile_data, std::vector<uint8_t>& buffer, int buffer_size_x, int buffer_size_y)
+void PPU::onRegisterWrite(uint16_t p_address, uint8_t p_value)
 {
-    if(buffer.size() != buffer_size_x * buffer_size_y)
+    if(!scanline_in_bulk || getLCDMode() != DRAWING_PIXELS) return;
+
+    // Nothing is drawn in skipped frames, so only the timing of mode 3 has to follow the write.
+    if(!drawing_frame)
     {
-        std::cout << "Buffer size doesn't match!" << std::endl;
+        if(p_address == 0xff40 || p_address == 0xff4b)
+        {
+            moveWindowStart(p_address, p_value);
+        }
         return;
     }
 
-    std::vector<uint8_t> tile;
-    for (int y = 0; y < 32; y++)
+    // Palettes and most LCDC bits are replayed by the scanline renderer. Writes that move the window start change the length of mode 3 
+    // and are left to the FIFO, as well as writes that don't fit into the register write log anymore.
+    bool replayable = memory.getRegisterWriteCount() < Memory::register_write_capacity;
+    if(p_address == 0xff4b)
+    {
+        replayable = false;
+    }
+    if(p_address == 0xff40 && ((lcdc_register ^ p_value) & (LCDC::LCD_AND_PPU_ENABLE | LCDC::WINDOW_ENABLE)))
+    {
+        replayable = false;
+    }
+    if(replayable) return;
+
+    // Replay the dots of this scanline that already passed and let the FIFO draw the rest of the scanline.
+    for (uint32_t i = 80; i < cycles; i++)
+    {
+        drawPixel(i);
+    }
+    scanline_in_bulk = false;
+}
+
+uint8_t PPU::readDrawingRegister(uint16_t p_address, uint32_t p_cycle) const
+{
+    if(p_cycle >= cycles)
+    {
+        return readRegister(p_address);
+    }
+
+    // Dots that already passed see the register value at the start of mode 3 changed by all writes logged until then.
+    uint8_t value = drawing_registers[p_address - 0xff40];
+    for (int i = 0; i < memory.getRegisterWriteCount(); i++)
     {
-        for (int x = 0; x < 32; x++)
+        const Memory::RegisterWrite& write = memory.getRegisterWrite(i);
+        if(write.cycle > p_cycle) break;
+        if(write.address == p_address)
         {
-            uint16_t tile_map_pointer = p_tile_map ? tile_map_2_pointer : tile_map_1_pointer;
-            uint8_t tile_index = memory.read(tile_map_pointer + (y * 32 + x), false);
-            uint16_t tile_base_pointer = p_tile_data ? tile_data_01_pointer + tile_index * 16 : tile_data_12_pointer + (int8_t)tile_index * 16;
-            getTile(tile_base_pointer, tile);
+            value = write.value;
+        }
+    }
+    return value;
+}
 
-            writeTileToBuffer(x * 8, y * 8, tile, buffer, buffer_size_x, buffer_size_y, false, false, false);
+bool PPU::getDrawingLCDCBit(LCDC p_mask, uint32_t p_cycle) const
+{
+    return p_mask & readDrawingRegister(0xff40, p_cycle);
+}
+
+void PPU::drawPixel(uint32_t p_cycle)
+{
+    // Draw window.
+    if(getDrawingLCDCBit(LCDC::WINDOW_ENABLE, p_cycle) && window_on_scanline && !window_triggered && output_x == readDrawingRegister(0xff4b, p_cycle) - 7)
+    {
+        // Reset fetch.
+        fetcher_cycles = 0;
+        fetcher_x = readDrawingRegister(0xff4b, p_cycle) / 8;
+        // Clear fifo.
+        fifo.clear();
+        // Objects left of the window start lose their pixels covered by the window.
+        composeObjectLayer(output_x);
+
+        window_triggered = true;
+    }
+
+    // Fetcher. 
+    if(fetcher_cycles == 0)
+    {
+        // Another 8 pixels are pulled every 8 dots (2 dots tile read, 2 dots read tiledata low, 2 dots readtile data high, 2 dots sleep/waiting until the FIFO has only 8 pixels left). 
+        fetchTile(p_cycle);
+
+        // Remove front pixels at start of scanline for scrolling.
+        if(p_cycle == 80)
+        {
+            fifo.discard(scroll_x % 8);
+        }
+
+        fetcher_x++;
+        fetcher_cycles = 8;
+    }
+
+    fetcher_cycles--;
+
+    // Push to LCD if there are at least 8 pixels in the FIFO.
+    if(fifo.size() > 8)
+    {
+        // Mix in the object layer. BG + Window colors 1-3 are drawn over objects if OBJ-to-BG priority is enabled.
+        Pixel pixel = fifo.front();
+        const Pixel& object_pixel = object_layer[output_x + 8];
+        if(object_pixel.color != 0 && !(object_pixel.background_priority && pixel.color != 0) && getDrawingLCDCBit(LCDC::OBJECT_ENABLE, p_cycle))
+        {
+            pixel = object_pixel;
+        }
+
+        // Apply palettes.
+        uint8_t pixel_palette = 0;
+        if(pixel.palette == PALETTE::BGP) pixel_palette = readDrawingRegister(0xff47, p_cycle);
+        if(pixel.palette == PALETTE::OBP0) pixel_palette = readDrawingRegister(0xff48, p_cycle);
+        if(pixel.palette == PALETTE::OBP1) pixel_palette = readDrawingRegister(0xff49, p_cycle);
+        uint8_t palette_color = (pixel_palette >> (pixel.color * 2)) & 0b11;
+
+        // Push to LCD.
+        if(output_x >= 0) // The first 8 empty pixels of each scanline won't be visible and are therefore just discarded.
+        {
+            screen_buffer[output_x + output_y * 160] = output_palette[palette_color];
+        }
+        fifo.pop();
+
+        output_x++;
+
+        // End of drawing pixels to this scanline.
+        if(output_x >= 160)  
+        {
+            endDrawing();
         }
     }
 }
 
-void PPU::tryFetchingObject(int p_x)
+void PPU::endDrawing()
 {
-    // Object fetcher. Object fetching has to be checked on every pixel. I couldn't find reliable resources about object rendering timing. 
-    // (Important to call after BG fetcher, since the BG fetcher can erase pixels from the fifo which might also erase object data if the object 
-    // was "merged" onto the lower 8 pixels in the fifo before.)
-    if(getLCDCBit(LCDC::OBJECT_ENABLE))
+    // Discard unnecessary data.
+    output_x = -8;
+    output_y++;
+    setLCDMode(HBLANK);
+
+    if(getSTATBit(STAT::HBLANK_STAT_INTERRUPT))
     {
-        for (int i = 0; i < objects_on_scanline.size(); i++)
+        cpu.requestInterrupt(SHARP_LR35902::Interrupt::LCD_STAT);
+    }
+
+    fifo.clear();
+    fetcher_cycles = 0;
+    fetcher_x = 0;
+    fetcher_y++;
+}
+
+int PPU::getWindowStart() const
+{
+    // The window starts at the pixel where the fetcher is reset for the window (WX - 7). Returns 160 if the window is not drawn on this scanline.
+    int window_start = window_x_register - 7;
+    if(!getLCDCBit(LCDC::WINDOW_ENABLE) || !window_on_scanline || window_start >= 160)
+    {
+        return 160;
+    }
+    return window_start;
+}
+
+void PPU::moveWindowStart(uint16_t p_address, uint8_t p_value)
+{
+    /*
+    Follows a write to LCDC or WX during mode 3 of a skipped frame without running the FIFO. The FIFO starts the window at the first dot 
+    where the next pixel is WX - 7 and the window is enabled. Once started, the window stays and the timing doesn't change anymore.
+    The window starts 8 dots before its first pixel is pushed, so the dot it started at follows from the end of mode 3.
+    */
+    if(drawing_window_start < 160 && drawing_end_cycle - 8 - (159 - drawing_window_start) < cycles)
+    {
+        return;
+    }
+
+    // Next pixel pushed out of the FIFO. The window hasn't started yet, so the pixels before this dot don't depend on it.
+    int next_x = -8;
+    while(next_x < 160 && getOutputCycle(next_x) < cycles)
+    {
+        next_x++;
+    }
+
+    uint8_t lcdc = p_address == 0xff40 ? p_value : lcdc_register;
+    int window_start = (p_address == 0xff4b ? p_value : window_x_register) - 7;
+    if(!(lcdc & LCDC::WINDOW_ENABLE) || !window_on_scanline || window_start >= 160 || window_start < next_x)
+    {
+        drawing_window_start = 160;
+        drawing_end_cycle = getOutputCycle(159);
+        return;
+    }
+
+    // If the FIFO already waits at the window start, the window starts right away. It takes 8 dots until its first pixel is pushed.
+    drawing_window_start = window_start;
+    uint32_t trigger_cycle = std::max(getOutputCycle(window_start - 1) + 1, cycles);
+    drawing_end_cycle = trigger_cycle + 8 + (159 - window_start);
+}
+
+uint32_t PPU::getOutputCycle(int p_x) const
+{
+    /*
+    Returns the cycle at which pixel p_x (-8 to 159) is pushed out of the FIFO. One pixel is pushed per dot starting at cycle 80, except when the FIFO stalls:
+    - Discarding SCX % 8 pixels at the start of the scanline stalls the FIFO for that many dots after the first tile.
+    - Starting the window clears the FIFO and stalls for 8 dots. If that happens before the first stall, the first stall never occurs.
+    */
+    if(p_x >= drawing_window_start)
+    {
+        return getOutputCycle(drawing_window_start - 1) + 1 + 8 + (p_x - drawing_window_start);
+    }
+    int pixel_index = p_x + 8;
+    int fine_scroll = scroll_x % 8;
+    return 80 + (pixel_index < 8 - fine_scroll ? pixel_index : pixel_index + fine_scroll);
+}
+
+uint32_t PPU::getFetchCycle(int p_x) const
+{
+    // Returns the cycle at which the tile containing pixel p_x (0 to 159) is fetched. The fetcher runs every 8 dots and restarts when the window starts.
+    if(p_x >= drawing_window_start)
+    {
+        return getOutputCycle(drawing_window_start - 1) + 1 + 8 * ((p_x - drawing_window_start) / 8);
+    }
+    return 80 + 8 * ((p_x + scroll_x % 8) / 8);
+}
+
+void PPU::renderScanline()
+{
+    /*
+    Draws the current scanline in one pass. The result is the same as pushing the scanline through the FIFO dot by dot: Register writes 
+    logged during mode 3 are replayed at the dot the FIFO would have read the register (tile fetch or pixel output).
+    */
+    std::array<uint8_t, 160> colors;
+    colors.fill(0);
+
+    // Background and window.
+    const TileRow* row = nullptr;
+    bool bg_enable = false;
+    int current_fetch = -1;
+    for (int x = 0; x < 160; x++)
+    {
+        int tile_x, tile_y, tile_row, tile_column, fetch;
+        bool is_window = x >= drawing_window_start;
+        if(is_window)
         {
-            int actual_object_height = objects_on_scanline[i].y - 16;
-            if(objects_on_scanline[i].x - 8 == p_x)
+            int window_column = x - drawing_window_start;
+            tile_x = (window_column / 8) & 0x1f;
+            tile_y = window_internal_counter / 8;
+            tile_row = window_internal_counter % 8;
+            tile_column = window_column % 8;
+            fetch = 0x100 | (window_column / 8); // Distinguish window fetches from background fetches.
+        }
+        else
+        {
+            int background_x = (scroll_x + x) & 255;
+            tile_x = background_x / 8;
+            tile_y = ((scroll_y + fetcher_y) & 255) / 8;
+            tile_row = ((scroll_y + fetcher_y) & 255) % 8;
+            tile_column = background_x % 8;
+            fetch = (x + scroll_x % 8) / 8;
+        }
+
+        // Only read new tile data when the pixel belongs to the next fetch.
+        if(fetch != current_fetch)
+        {
+            uint8_t lcdc = readDrawingRegister(0xff40, getFetchCycle(x));
+            uint16_t tilemap_address = (lcdc & (is_window ? LCDC::WINDOW_TILE_MAP : LCDC::BG_TILE_MAP)) ? tile_map_2_pointer : tile_map_1_pointer;
+            uint8_t tile_index = memory.read(tilemap_address + (tile_x + 32 * tile_y), false);
+            uint16_t tile_data_pointer = (lcdc & LCDC::BG_AND_WIN_TILE_DATA) ? (tile_data_01_pointer + tile_index * 16) : (tile_data_12_pointer + (int8_t)tile_index * 16);
+            row = &getTileRow(getTileNumber(tile_data_pointer), tile_row, false);
+            bg_enable = lcdc & LCDC::BG_AND_WINDOW_ENABLE;
+            current_fetch = fetch;
+
+            if constexpr(debug_probes_enabled)
             {
-                uint8_t tile_index = 0;
-                uint16_t tile_data_pointer = 0;
-                int tile_row = 0;
-                int tiledata_low = 0;
-                int tiledata_high = 0;
-                if(getLCDCBit(LCDC::OBJECT_SIZE))
+                if(probe_enabled) probeFetch(tile_x, tile_y, tile_row, tilemap_address + (tile_x + 32 * tile_y), tile_data_pointer);
+            }
+        }
+
+        if(bg_enable)
+        {
+            colors[x] = (*row)[tile_column];
+        }
+    }
+
+    // Like in the FIFO, objects left of the window start lose their pixels covered by the window.
+    if(drawing_window_start < 160)
+    {
+        composeObjectLayer(drawing_window_start);
+    }
+
+    // Mix in the object layer, apply palettes and push to LCD.
+    uint8_t lcdc = drawing_registers[0];
+    std::array<uint8_t, 3> palette_registers = { drawing_registers[0xff47 - 0xff40], drawing_registers[0xff48 - 0xff40], drawing_registers[0xff49 - 0xff40] };
+    int next_write = 0;
+    for (int x = 0; x < 160; x++)
+    {
+        if(memory.getRegisterWriteCount() > 0)
+        {
+            // Apply LCDC and palette writes that happened until this pixel is pushed out.
+            uint32_t output_cycle = getOutputCycle(x);
+            while(next_write < memory.getRegisterWriteCount() && memory.getRegisterWrite(next_write).cycle <= output_cycle)
+            {
+                const Memory::RegisterWrite& write = memory.getRegisterWrite(next_write);
+                if(write.address == 0xff40)
                 {
-                    tile_index = objects_on_scanline[i].tile_index & 0xfe;
-                    tile_data_pointer = 0x8000 + tile_index * 16;
-                    tile_row = objects_on_scanline[i].y_flip ? (15 - (fetcher_y - actual_object_height)) : (fetcher_y - actual_object_height);
-
-                    if(tile_row < 8)
-                    {
-                        tiledata_low = memory.read(tile_data_pointer + 2 * tile_row, false);
-                        tiledata_high = memory.read(tile_data_pointer + 2 * tile_row + 1, false);
-                    }
-                    else
-                    {
-                        tiledata_low = memory.read(tile_data_pointer + 16 + 2 * (tile_row - 8), false);
-                        tiledata_high = memory.read(tile_data_pointer + 16 + 2 * (tile_row - 8) + 1, false);
-                    }
+                    lcdc = write.value;
                 }
-                else
+                if(write.address >= 0xff47 && write.address <= 0xff49)
                 {
-                    tile_index = objects_on_scanline[i].tile_index;
-                    tile_data_pointer = 0x8000 + tile_index * 16;
-                    tile_row = objects_on_scanline[i].y_flip ? (7 - (fetcher_y - actual_object_height)) : (fetcher_y - actual_object_height);
-
-                    tiledata_low = memory.read(tile_data_pointer + 2 * tile_row, false);
-                    tiledata_high = memory.read(tile_data_pointer + 2 * tile_row + 1, false);
+                    palette_registers[write.address - 0xff47] = write.value;
                 }
+                next_write++;
+            }
+        }
 
-                for(int j = 0; j < 8; j++)
-                {
-                    uint8_t msbit = (tiledata_high >> j) & 1;
-                    uint8_t lsbit = (tiledata_low >> j) & 1;
-                    uint8_t color = (msbit << 1) | lsbit;
-                    
-                    int pixel_index = objects_on_scanline[i].x_flip ? j : (7 - j);
-                    if(pixel_index >= fifo.size()) continue;
-                    if(objects_on_scanline[i].priority && fifo[pixel_index].color != 0) continue; // Draw BG + Window colors 1-3 over objects if OBJ-to-BG priority is enabled.
-                    if(color != 0 && fifo[pixel_index].palette == PALETTE::BGP) // Only draw the object if the underlying pixel is from the background (essentially, the first sprite that comes will stay -> sprites later in oam or with higher x position will be drawn below this sprite). Also don't draw transparent pixels (color 0b00).
-                    {
-                        fifo[pixel_index].color = color;
-                        fifo[pixel_index].palette = objects_on_scanline[i].palette_number ? PALETTE::OBP1 : PALETTE::OBP0;
-                        fifo[pixel_index].background_priority = objects_on_scanline[i].priority;
-                    }
-                }
+        uint8_t color = colors[x];
+        uint8_t palette = PALETTE::BGP;
+        const Pixel& object_pixel = object_layer[x + 8];
+        if(object_pixel.color != 0 && !(object_pixel.background_priority && color != 0) && (lcdc & LCDC::OBJECT_ENABLE))
+        {
+            color = object_pixel.color;
+            palette = object_pixel.palette;
+        }
+        screen_buffer[x + output_y * 160] = output_palette[(palette_registers[palette] >> (color * 2)) & 0b11];
+    }
+
+    if(drawing_window_start < 160)
+    {
+        window_triggered = true;
+    }
+}
+
+void PPU::getTile(uint16_t p_address, std::vector<uint8_t>& p_pixels) const 
+{
+    if(p_pixels.size() != 64)
+    {
+        p_pixels.resize(64, 0);
+    }
+    int tile_number = getTileNumber(p_address);
+    for (int row = 0; row < 8; row++)
+    {
+        const TileRow& tile_row = getTileRow(tile_number, row, false);
+        std::copy(tile_row.begin(), tile_row.end(), p_pixels.begin() + row * 8);
+    }
+}
+
+void PPU::onVRAMWrite(uint16_t p_address)
+{
+    vram_version++;
+    if(p_address >= 0x8000 && p_address <= 0x97ff)
+    {
+        dirty_tile_rows[(p_address - 0x8000) / 2] = true;
+        tile_versions[(p_address - 0x8000) / 16]++;
+    }
+    else if(p_address >= tile_map_1_pointer && p_address <= 0x9fff)
+    {
+        // Only views showing the written tile map have to redraw the entry. Views switching to another tile map are rebuilt anyway.
+        bool tile_map = p_address >= tile_map_2_pointer;
+        int entry = (p_address - tile_map_1_pointer) % 1024;
+        if(background_view.tile_map == tile_map) background_view.dirty_entries[entry] = true;
+        if(window_view.tile_map == tile_map) window_view.dirty_entries[entry] = true;
+    }
+}
+
+const PPU::TileRow& PPU::getTileRow(int p_tile_number, int p_row, bool p_flip) const
+{
+    int index = p_tile_number * 8 + p_row;
+    if(dirty_tile_rows[index])
+    {
+        uint8_t tiledata_low = memory.read(0x8000 + index * 2, false);
+        uint8_t tiledata_high = memory.read(0x8000 + index * 2 + 1, false);
+        decodeTileRow(tiledata_low, tiledata_high, tile_rows[index].data());
+        decodeTileRow(tiledata_low, tiledata_high, flipped_tile_rows[index].data(), true);
+        dirty_tile_rows[index] = false;
+    }
+    return p_flip ? flipped_tile_rows[index] : tile_rows[index];
+}
+
+int PPU::getTileNumber(uint16_t p_address) const
+{
+    return ((p_address - 0x8000) / 16) % 384;
+}
+
+void PPU::updateTileMapView(TileMapView& p_view, bool p_tile_map, bool p_tile_data)
+{
+    bool rebuild = !p_view.built || p_view.tile_map != p_tile_map || p_view.tile_data != p_tile_data;
+    if(!rebuild && p_view.vram_version == vram_version)
+    {
+        return;
+    }
+
+    uint16_t tile_map_pointer = p_tile_map ? tile_map_2_pointer : tile_map_1_pointer;
+    for (int entry = 0; entry < 1024; entry++)
+    {
+        if(rebuild || p_view.dirty_entries[entry])
+        {
+            uint8_t tile_index = memory.read(tile_map_pointer + entry, false);
+            uint16_t tile_base_pointer = p_tile_data ? tile_data_01_pointer + tile_index * 16 : tile_data_12_pointer + (int8_t)tile_index * 16;
+            p_view.drawn_tiles[entry] = getTileNumber(tile_base_pointer);
+            p_view.dirty_entries[entry] = false;
+        }
+        else if(p_view.drawn_versions[entry] == tile_versions[p_view.drawn_tiles[entry]])
+        {
+            continue;
+        }
+
+        // Write the decoded rows of the tile straight into the view.
+        int tile_number = p_view.drawn_tiles[entry];
+        p_view.drawn_versions[entry] = tile_versions[tile_number];
+        for (int row = 0; row < 8; row++)
+        {
+            const TileRow& tile_row = getTileRow(tile_number, row, false);
+            uint32_t* pixels = &p_view.pixels[((entry / 32) * 8 + row) * 256 + (entry % 32) * 8];
+            for (int i = 0; i < 8; i++)
+            {
+                pixels[i] = rgba_palette[tile_row[i]];
+            }
+        }
+    }
+
+    p_view.built = true;
+    p_view.tile_map = p_tile_map;
+    p_view.tile_data = p_tile_data;
+    p_view.vram_version = vram_version;
+}
+
+void PPU::composeObjectLayer(int p_start_x)
+{
+    // Objects are merged from left to right, so the first non transparent object pixel stays. The object size is read at the end of mode 2.
+    for (int x = p_start_x; x < 160; x++)
+    {
+        object_layer[x + 8] = {};
+    }
+    for (int i = 0; i < object_count; i++)
+    {
+        const Object& object = objects_on_scanline[i];
+        int object_x = object.x - 8;
+        if(object_x < p_start_x) continue;
+        if(object_x >= 160) break;
+
+        // Objects are 1 tile (8x8) or 2 tiles (8x16) high. Only the lower bits of the row within the object are used.
+        int actual_object_height = object.y - 16;
+        int tile_index = 0;
+        int tile_row = 0;
+        if(drawing_registers[0] & LCDC::OBJECT_SIZE)
+        {
+            tile_row = (object.y_flip ? (15 - (fetcher_y - actual_object_height)) : (fetcher_y - actual_object_height)) & 15;
+            tile_index = (object.tile_index & 0xfe) + tile_row / 8;
+        }
+        else
+        {
+            tile_row = (object.y_flip ? (7 - (fetcher_y - actual_object_height)) : (fetcher_y - actual_object_height)) & 7;
+            tile_index = object.tile_index;
+        }
+        const TileRow& row = getTileRow(tile_index, tile_row % 8, object.x_flip);
+
+        for (int j = 0; j < 8 && object_x + j < 160; j++)
+        {
+            Pixel& pixel = object_layer[object_x + j + 8];
+            if(pixel.color == 0 && row[j] != 0)
+            {
+                pixel.color = row[j];
+                pixel.palette = object.palette_number ? PALETTE::OBP1 : PALETTE::OBP0;
+                pixel.background_priority = object.priority;
             }
         }
     }
 }
 
-void PPU::fetchTile()
+void PPU::fetchTile(uint32_t p_cycle)
 {
     uint16_t current_tilemap_address = 0;
     int tile_x = 0; // Fetcher keeps track of the tile it is on.
@@ -507,81 +1013,98 @@ void PPU::fetchTile()
     int tile_row = 0; // We now know the tile we want to push data from to the FIFO next, but we also need to know which row of the tile overlaps the current scanline.
     if(window_triggered)
     {
-        current_tilemap_address = getLCDCBit(LCDC::WINDOW_TILE_MAP) ? 0x9c00 : 0x9800;
-        tile_x = (fetcher_x - (memory.read(0xff4b) / 8)) & 0x1f; // Fetcher keeps track of the tile it is on.
+        current_tilemap_address = getDrawingLCDCBit(LCDC::WINDOW_TILE_MAP, p_cycle) ? 0x9c00 : 0x9800;
+        tile_x = (fetcher_x - (readDrawingRegister(0xff4b, p_cycle) / 8)) & 0x1f; // Fetcher keeps track of the tile it is on.
         tile_y = (window_internal_counter & 255) / 8;
         tile_row = (window_internal_counter & 255) % 8;
     }
     else
     {
-        current_tilemap_address = getLCDCBit(LCDC::BG_TILE_MAP) ? 0x9c00 : 0x9800;
+        current_tilemap_address = getDrawingLCDCBit(LCDC::BG_TILE_MAP, p_cycle) ? 0x9c00 : 0x9800;
         tile_x = ((scroll_x / 8) + fetcher_x) & 0x1f; // Fetcher keeps track of the tile it is on.
         tile_y = ((scroll_y + fetcher_y) & 255) / 8;
         tile_row = ((scroll_y + fetcher_y) & 255) % 8;
     }
     uint16_t current_tile_address = current_tilemap_address + (tile_x + 32 * tile_y);
-    uint16_t tile_data_pointer = getLCDCBit(LCDC::BG_AND_WIN_TILE_DATA) ? (0x8000 + memory.read(current_tile_address, false) * 16) : (0x9000 + (int8_t)memory.read(current_tile_address, false) * 16);
+    uint16_t tile_data_pointer = getDrawingLCDCBit(LCDC::BG_AND_WIN_TILE_DATA, p_cycle) ? (0x8000 + memory.read(current_tile_address, false) * 16) : (0x9000 + (int8_t)memory.read(current_tile_address, false) * 16);
 
+    // Push the new pixels to the FIFO.
+    const TileRow& row = getTileRow(getTileNumber(tile_data_pointer), tile_row, false);
+    bool bg_enable = getDrawingLCDCBit(LCDC::BG_AND_WINDOW_ENABLE, p_cycle);
+    for(int j = 0; j < 8; j++)
+    {
+        uint8_t color = bg_enable ? row[j] : 0;
+        fifo.push({ color, PALETTE::BGP, false });
+    }
+
+    if constexpr(debug_probes_enabled)
+    {
+        if(probe_enabled) probeFetch(tile_x, tile_y, tile_row, current_tile_address, tile_data_pointer);
+    }
+}
+
+void PPU::probeFetch(int p_tile_x, int p_tile_y, int p_tile_row, uint16_t p_tile_map_address, uint16_t p_tile_data_address)
+{
+    probe.tile_x = p_tile_x;
+    probe.tile_y = p_tile_y;
+    probe.tile_row = p_tile_row;
+    probe.tile_map_address = p_tile_map_address;
+    probe.tile_index = memory.read(p_tile_map_address, false);
+    probe.tile_data_address = p_tile_data_address;
     // Since each tile consists of 16 bytes of data, a row of 8 pixels has 2 bytes data.
-    int tiledata_low = memory.read(tile_data_pointer + 2 * tile_row, false); // Reading VRAM is locked during Mode 3, but not for the PPU since it has to draw something. Therefore restrictions can be disabled for a software component.
-    int tiledata_high = memory.read(tile_data_pointer + 2 * tile_row + 1, false);
+    probe.tile_data_low = memory.read(p_tile_data_address + 2 * p_tile_row, false);
+    probe.tile_data_high = memory.read(p_tile_data_address + 2 * p_tile_row + 1, false);
 
-    // Convert the byte data to color information and push the new pixels to the FIFO.
-    for(int j = 7; j >= 0; j--)
+    probe.fifo_size = fifo.size();
+    for (int i = 0; i < fifo.size(); i++)
     {
-        uint8_t msbit = (tiledata_high >> j) & 1;
-        uint8_t lsbit = (tiledata_low >> j) & 1;
-        fifo.push_back( { getLCDCBit(LCDC::BG_AND_WINDOW_ENABLE) ? ((msbit << 1) | lsbit) : 0, PALETTE::BGP, false } );
+        probe.fifo_colors[i] = fifo[i].color;
     }
+}
 
-    info_text = std::to_string(tile_x) + ", " + std::to_string(tile_y) + ": TileMap " + std::to_string(current_tile_address) + " Offset " + std::to_string(memory.read(current_tile_address, false)) + " TilePointer " + std::to_string(tile_data_pointer) + " TileRow " + std::to_string(tile_row) + " TileData " + std::to_string(tiledata_low) + ", " + std::to_string(tiledata_high) + "\n";
+void PPU::onOAMWrite(uint16_t p_address)
+{
+    int index = (p_address - oam_start) / 4;
+    uint16_t object_address = oam_start + index * 4;
+    Object& object = objects[index];
+    uint8_t old_y = object.y;
+
+    // Sprite position.
+    object.y = memory.read(object_address, false);
+    object.x = memory.read(object_address + 1, false);
+    // Tile index.
+    object.tile_index = memory.read(object_address + 2, false);
+    // Attributes.
+    uint8_t attributes = memory.read(object_address + 3, false);
+    object.priority = attributes & 0b10000000;
+    object.x_flip = attributes & 0b00100000;
+    object.y_flip = attributes & 0b01000000;
+    object.palette_number = attributes & 0b00010000;
+
+    if(object.y != old_y) object_buckets_dirty = true;
 }
 
-void PPU::writeTileToBuffer(int start_x, int start_y, std::vector<uint8_t>& tile, std::vector<uint8_t>& buffer, int buffer_size_x, int buffer_size_y, bool is_transparent, bool flip_x, bool flip_y)
+void PPU::updateObjectBuckets()
 {
-    if(tile.size() != 64 || buffer.size() != buffer_size_x * buffer_size_y)
+    bool tall = getLCDCBit(LCDC::OBJECT_SIZE);
+    if(!object_buckets_dirty && tall == object_buckets_tall) return;
+
+    for (size_t i = 0; i < object_buckets.size(); i++)
     {
-        std::cout << "Wrong tile size or buffer doesn't match size!" << std::endl;
-        return;
+        object_buckets[i].count = 0;
     }
-
-    for (int y = 0; y < 8; y++)
+    // Objects are added in OAM order, so the first 10 objects on a line are kept.
+    int height = tall ? 16 : 8;
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        for (int x = 0; x < 8; x++)
+        int top = objects[i].y - 16;
+        for (int line = std::max(top, 0); line < std::min(top + height, 144); line++)
         {
-            int flipped_x = flip_x ? 7 - x : x;
-            int flipped_y = flip_y ? 7 - y : y;
-
-            uint8_t current_pixel = tile[flipped_y * 8 + flipped_x];
-
-            if((current_pixel == 0) && is_transparent) continue;
-
-            uint8_t offset_x = start_x + x;
-            uint8_t offset_y = start_y + y;
-            if(offset_y < buffer_size_y && offset_x < buffer_size_x)
-            {
-                buffer[offset_y * buffer_size_x + offset_x] = current_pixel;
-            }
+            ObjectBucket& bucket = object_buckets[line];
+            if(bucket.count < 10) bucket.objects[bucket.count++] = i;
         }
     }
-}
 
-void PPU::writeOAMToBuffer()
-{
-    uint16_t object_address = oam_start;
-    for (int i = 0; i < objects.size(); i++)
-    {
-        // Sprite position.
-        objects[i].y = memory.read(object_address, false);
-        objects[i].x = memory.read(object_address + 1, false);
-        // Tile index.
-        objects[i].tile_index = memory.read(object_address + 2, false);
-        // Attributes.
-        objects[i].priority = memory.read(object_address + 3, false) & 0b10000000;
-        objects[i].x_flip = memory.read(object_address + 3, false) & 0b00100000;
-        objects[i].y_flip = memory.read(object_address + 3, false) & 0b01000000;
-        objects[i].palette_number = memory.read(object_address + 3, false) & 0b00010000;
-
-        object_address += 4;
-    }
+    object_buckets_dirty = false;
+    object_buckets_tall = tall;
 }
@@ -0,0 +1,154 @@
+#include "sfml_audio_sink.hpp"
+
+#include <algorithm>
+
+SFMLAudioSink::SFMLAudioSink(int p_batch_size)
+{
+    setBufferSize(p_batch_size);
+}
+
+SFMLAudioSink::~SFMLAudioSink()
+{
+    // The audio thread has to be finished before the ring it reads from is destroyed.
+    sf::SoundStream::stop();
+}
+
+void SFMLAudioSink::start(int p_sample_rate)
+{
+    if(p_sample_rate != sample_rate || getChannelCount() == 0)
+    {
+        sample_rate = p_sample_rate;
+        initialize(1, sample_rate);
+    }
+    samples_played = 0;
+    play();
+}
+
+void SFMLAudioSink::stop()
+{
+    sf::SoundStream::stop();
+}
+
+bool SFMLAudioSink::isPlaying() const
+{
+    return getStatus() == sf::SoundStream::Playing;
+}
+
+void SFMLAudioSink::write(const int16_t* p_samples, int p_count)
+{
+    for (int i = 0; i < p_count; i++)
+    {
+        sample_ring.push(p_samples[i]);
+    }
+}
+
+double SFMLAudioSink::getClock() const
+{
+    if(!isPlaying())
+    {
+        return -1;
+    }
+    uint64_t played = samples_played;
+    if(played == 0)
+    {
+        return 0;
+    }
+
+    // The last chunk pulled starts playing when the previous one ended, so it counts as playing from the pull on.
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    double chunk_duration = (double)sample_batch_size / sample_rate;
+    double elapsed = std::min((now - last_pull_time) / 1e9, chunk_duration);
+    return (double)(played - sample_batch_size) / sample_rate + elapsed;
+}
+
+int SFMLAudioSink::getBufferFill() const
+{
+    return sample_ring.size();
+}
+
+int SFMLAudioSink::getTargetFill() const
+{
+    // SFML pulls a whole chunk at once, so the ring holds one to two chunks most of the time.
+    return 2 * sample_batch_size;
+}
+
+uint64_t SFMLAudioSink::getUnderruns() const
+{
+    return underruns;
+}
+
+double SFMLAudioSink::getLatency() const
+{
+    return (double)(getBufferFill() + device_buffer_count * sample_batch_size) / sample_rate;
+}
+
+void SFMLAudioSink::setBufferSize(int p_samples)
+{
+    bool playing = isPlaying();
+    if(playing)
+    {
+        sf::SoundStream::stop();
+    }
+
+    sample_batch_size = std::clamp(p_samples, (int)min_batch_size, (int)max_batch_size);
+    samples.assign(sample_batch_size, last_sample);
+
+    // The audio thread isn't running, so the ring can be read here. Samples buffered beyond the new target are dropped, the rate control
+    // would take seconds to drain them.
+    sf::Int16 discarded[256];
+    while(getBufferFill() > getTargetFill())
+    {
+        sample_ring.pop(discarded, std::min(256, getBufferFill() - getTargetFill()));
+    }
+
+    if(playing)
+    {
+        start(sample_rate);
+    }
+}
+
+int SFMLAudioSink::getBufferSize() const
+{
+    return sample_batch_size;
+}
+
+void SFMLAudioSink::setVolume(float p_volume)
+{
+    sf::SoundStream::setVolume(p_volume);
+}
+
+float SFMLAudioSink::getVolume() const
+{
+    return sf::SoundStream::getVolume();
+}
+
+bool SFMLAudioSink::onGetData(Chunk& data)
+{
+    // If the emulator falls behind, the rest of the chunk is filled with the last sample. Returning less (or nothing) would stop the stream.
+    int count = sample_ring.pop(samples.data(), sample_batch_size);
+    if(count > 0)
+    {
+        last_sample = samples[count - 1];
+    }
+    if(count < sample_batch_size)
+    {
+        underruns++;
+    }
+    for (int i = count; i < sample_batch_size; i++)
+    {
+        samples[i] = last_sample;
+    }
+
+    data.sampleCount = sample_batch_size;
+    data.samples = samples.data();
+
+    last_pull_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    samples_played += sample_batch_size;
+
+    return true;
+}
+
+void SFMLAudioSink::onSeek(sf::Time timeOffset)
+{
+    // Cannot be implemented.
+}
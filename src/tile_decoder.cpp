@@ -0,0 +1,38 @@
+#include "tile_decoder.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace
+{
+    struct SpreadTable
+    {
+        // bytes[b][i] holds bit (7 - i) of b, flipped_bytes[b][i] holds bit i of b.
+        std::array<std::array<uint8_t, 8>, 256> bytes;
+        std::array<std::array<uint8_t, 8>, 256> flipped_bytes;
+
+        SpreadTable()
+        {
+            for (int b = 0; b < 256; b++)
+            {
+                for (int i = 0; i < 8; i++)
+                {
+                    bytes[b][i] = (b >> (7 - i)) & 1;
+                    flipped_bytes[b][i] = (b >> i) & 1;
+                }
+            }
+        }
+    };
+    const SpreadTable spread_table;
+}
+
+void decodeTileRow(uint8_t p_low, uint8_t p_high, uint8_t* p_pixels, bool p_flip)
+{
+    // Every byte of the spread table is 0 or 1, so both planes can be combined as 64-bit integers without carrying into the next pixel.
+    const std::array<std::array<uint8_t, 8>, 256>& table = p_flip ? spread_table.flipped_bytes : spread_table.bytes;
+    uint64_t low, high;
+    std::memcpy(&low, table[p_low].data(), 8);
+    std::memcpy(&high, table[p_high].data(), 8);
+    uint64_t row = low | (high << 1);
+    std::memcpy(p_pixels, &row, 8);
+}
@@ -1,6 +1,9 @@
 #include "timing.hpp"
 
+#if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
+#endif
+#include <chrono>
 #include <thread>
 #include <iostream>
 
@@ -14,6 +17,8 @@ uint64_t getCurrentTimeInMicroseconds()
     LARGE_INTEGER time;
     QueryPerformanceCounter(&time);
     return static_cast<uint64_t>(time.QuadPart * inverse);
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 #endif
 }
 
@@ -24,6 +29,8 @@ void sleepMicroseconds(uint64_t amount)
     uint64_t end_time = start_time + amount;
 
     while(getCurrentTimeInMicroseconds() < end_time);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds(amount));
 #endif
 }
 
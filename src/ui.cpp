@@ -1,5 +1,8 @@
 #include "ui.hpp"
 #include "emulator.hpp"
+#if EMULGATOR_SFML_AUDIO
+#include "sfml_audio_sink.hpp"
+#endif
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -131,6 +134,8 @@ Debugger::Debugger(ui::Canvas& p_canvas, Emulator& p_emulator, std::mutex& p_mut
     canvas(p_canvas)
 {
     init();
+    // The display uploads the frames to a texture as they are.
+    emulator.setOutputFormat(PPU::RGBA8888);
 }
 
 void Debugger::init()
@@ -140,11 +145,13 @@ void Debugger::init()
     display_panel->setTitle("Display");
     display_graphic = display_panel->createGraphic();
     display_graphic->setScale(sf::Vector2f(4.f, 4.f));
+    display_graphic_texture.create(emulator.getPPU().screen_width, emulator.getPPU().screen_height);
 
     // Background.
     background_panel = dockspace.createPanel("Background");
     background_graphic = background_panel->createGraphic();
     background_graphic->setScale(sf::Vector2f(4.f, 4.f));
+    background_graphic_texture.create(emulator.getPPU().actual_screen_width, emulator.getPPU().actual_screen_height);
     dockspace.insertPanel(background_panel, display_panel, 4);
 
     // Cartridge.
@@ -184,6 +191,13 @@ void Debugger::init()
     speed_text->setSize(sf::Vector2f(35.f, 20.f));
     cartridge_panel->createButton(">", [this](){ if(emulator.getSpeed() >= 1000) return; emulator.setSpeed(emulator.getSpeed() + 5); speed_text->setString(ui::toString(emulator.getSpeed()) + "%"); });
     cartridge_panel->breakLine();
+
+    // Frame skip. Draw 1 of every N frames.
+    cartridge_panel->createButton("<", [this](){ if(emulator.getFrameSkip() <= 1) return; emulator.setFrameSkip(emulator.getFrameSkip() - 1); frame_skip_text->setString("1/" + ui::toString(emulator.getFrameSkip()) + " frames"); });
+    frame_skip_text = cartridge_panel->createText("1/" + ui::toString(emulator.getFrameSkip()) + " frames");
+    frame_skip_text->setSize(sf::Vector2f(80.f, 20.f));
+    cartridge_panel->createButton(">", [this](){ if(emulator.getFrameSkip() >= 10) return; emulator.setFrameSkip(emulator.getFrameSkip() + 1); frame_skip_text->setString("1/" + ui::toString(emulator.getFrameSkip()) + " frames"); });
+    cartridge_panel->breakLine();
     
     metrics_text = cartridge_panel->createText("");
     metrics_text->setSize(sf::Vector2f(500.f, 100.f));
@@ -209,6 +223,7 @@ void Debugger::init()
     dockspace.insertPanel(window_panel, display_panel, 4);
     window_graphic = window_panel->createGraphic();
     window_graphic->setScale(sf::Vector2f(4.f, 4.f));
+    window_graphic_texture.create(emulator.getPPU().actual_screen_width, emulator.getPPU().actual_screen_height);
 
     // VRAM viewer.
     vram_panel = dockspace.createPanel("VRAM Viewer");
@@ -240,7 +255,7 @@ void Debugger::init()
     apu_panel = dockspace.createPanel("APU");
 
     apu_general = apu_panel->createText("General");
-    apu_general->setSize(sf::Vector2f(400.f, 90.f));
+    apu_general->setSize(sf::Vector2f(400.f, 150.f));
     apu_panel->breakLine();
 
     apu_panel->createButton("<", [this](){ emulator.setVolume(emulator.getVolume() - 5.f); volume_text->setString(ui::toString(emulator.getAPU().getVolume(), 0) + "%"); });
@@ -249,6 +264,32 @@ void Debugger::init()
     apu_panel->createButton(">", [this](){ emulator.setVolume(emulator.getVolume() + 5.f); volume_text->setString(ui::toString(emulator.getAPU().getVolume(), 0) + "%"); });
     apu_panel->breakLine();
 
+    #if EMULGATOR_SFML_AUDIO
+    // Audio buffer size. Halved or doubled, low latency switches between the low latency and the default size.
+    apu_panel->createButton("<", [this](){ emulator.setAudioBufferSize(emulator.getAudioBufferSize() / 2); buffer_size_text->setString(ui::toString(emulator.getAudioBufferSize()) + " samples"); });
+    buffer_size_text = apu_panel->createText(ui::toString(emulator.getAudioBufferSize()) + " samples");
+    buffer_size_text->setSize(sf::Vector2f(90.f, 20.f));
+    apu_panel->createButton(">", [this](){ emulator.setAudioBufferSize(emulator.getAudioBufferSize() * 2); buffer_size_text->setString(ui::toString(emulator.getAudioBufferSize()) + " samples"); });
+    apu_panel->createButton("Low latency", [this]()
+    {
+        bool low_latency = emulator.getAudioBufferSize() <= SFMLAudioSink::low_latency_batch_size;
+        emulator.setAudioBufferSize(low_latency ? SFMLAudioSink::default_batch_size : SFMLAudioSink::low_latency_batch_size);
+        buffer_size_text->setString(ui::toString(emulator.getAudioBufferSize()) + " samples");
+    });
+    apu_panel->breakLine();
+    #endif
+
+    apu_panel->createButton("Quality", [this]()
+    {
+        // Cycles through low, medium and high.
+        BlipBuffer::Quality quality = emulator.getAudioQuality();
+        emulator.setAudioQuality(quality == BlipBuffer::LOW ? BlipBuffer::MEDIUM : quality == BlipBuffer::MEDIUM ? BlipBuffer::HIGH : BlipBuffer::LOW);
+    });
+    apu_panel->createButton("Record", [this](){ emulator.startRecording("recording.wav", false); });
+    apu_panel->createButton("Record stems", [this](){ emulator.startRecording("recording.wav", true); });
+    apu_panel->createButton("Stop", [this](){ emulator.stopRecording(); });
+    apu_panel->breakLine();
+
     apu_ch1 = apu_panel->createText("Channel 1");
     apu_ch1->setSize(sf::Vector2f(400.f, 90.f));
     apu_panel->breakLine();
@@ -314,33 +355,52 @@ void Debugger::updateEvents(sf::Event& p_event)
 
 void Debugger::updateLogic()
 {
-    mutex.lock();
+    // Display. The latest frame is taken from the PPU without locking, so the emulator never waits for the UI here.
+    // The PPU already writes RGBA pixels, so they are uploaded as they are.
+    const PPU::Frame& frame = emulator.getLatestFrame();
+    display_graphic_texture.update(reinterpret_cast<const sf::Uint8*>(frame.data()));
+    display_graphic->setTexture(&display_graphic_texture);
 
-    // APU.
-    for (int i = 0; i < emulator.getAPU().ch1_sample_list.size(); i+=8)
+    // The channel scopes are only captured while the APU panel is shown.
+    if(apu_panel->isVisible() != channel_scopes_enabled)
     {
-        ch1_graph->setNext(emulator.getAPU().ch1_sample_list[i]/20000.f);
+        channel_scopes_enabled = apu_panel->isVisible();
+        emulator.enableChannelScopes(channel_scopes_enabled);
     }
-    for (int i = 0; i < emulator.getAPU().ch2_sample_list.size(); i+=8)
+    // Same for the debug probes of the PPU and CPU.
+    if(ppu_panel->isVisible() != ppu_probe_enabled || cpu_panel->isVisible() != cpu_probe_enabled)
     {
-        ch2_graph->setNext(emulator.getAPU().ch2_sample_list[i]/20000.f);
+        ppu_probe_enabled = ppu_panel->isVisible();
+        cpu_probe_enabled = cpu_panel->isVisible();
+        emulator.attachDebugger(ppu_probe_enabled, cpu_probe_enabled);
     }
-    for (int i = 0; i < emulator.getAPU().ch3_sample_list.size(); i+=8)
-    {
-        ch3_graph->setNext(emulator.getAPU().ch3_sample_list[i]/20000.f);
-    }
-    for (int i = 0; i < emulator.getAPU().ch4_sample_list.size(); i+=8)
+
+    mutex.lock();
+
+    // APU.
+    if(channel_scopes_enabled)
     {
-        ch4_graph->setNext(emulator.getAPU().ch4_sample_list[i]/20000.f);
+        std::array<FunctionGraph*, 4> graphs = { ch1_graph, ch2_graph, ch3_graph, ch4_graph };
+        for (int channel = 1; channel <= 4; channel++)
+        {
+            emulator.getAPU().getScopeSnapshot(channel, scope_snapshot.data(), scope_snapshot.size());
+            for (int i = 0; i < scope_snapshot.size(); i+=8)
+            {
+                graphs[channel - 1]->setNext(scope_snapshot[i]/20000.f);
+            }
+        }
     }
 
     std::array<sf::String, 4> duty_cycle_string = { "12,5%", "25%", "50%", "75%" };
-    std::array<sf::String, 3> audio_status = { "Stopped", "Paused", "Playing" };
 
     apu_general->setString(sf::String("General\n") +
-    "Audio enabled: " + audio_status[emulator.getAPU().getStatus()] + "\n"
+    "Audio enabled: " + (emulator.getAPU().isPlaying() ? "Playing" : "Stopped") + "\n"
     "NR52 (0xff26): " + ui::toBinaryString(emulator.getMemory().read(0xff26)) + "\n"
     "div_apu: " + ui::toHexString(emulator.getAPU().div_apu, true, 2) + "\n" +
+    "Buffer: " + ui::toString(emulator.getAPU().getBufferFill()) + " samples, underruns: " + ui::toString(emulator.getAPU().getUnderruns()) +
+    ", rate: " + ui::toString(emulator.getAPU().getRateAdjustment() * 100, 2) + "%\n" +
+    "Quality: " + (emulator.getAPU().getQuality() == BlipBuffer::LOW ? "Low" : emulator.getAPU().getQuality() == BlipBuffer::MEDIUM ? "Medium" : "High") + "\n" +
+    "Recording: " + (emulator.getAPU().isRecording() ? "Yes" : "No") + " (dropped frames: " + ui::toString(emulator.getAPU().getDroppedRecordingFrames()) + ")\n" +
     "dots/seconds: " + ui::toString(emulator.getAPU().cycle_count_per_second) + "\n");
 
     apu_ch1->setString(sf::String("Channel 1: ") + (emulator.getAPU().ch1_active ? "Active" : "Inactive") + "\n"
@@ -371,50 +431,29 @@ void Debugger::updateLogic()
     "Clock divider: " + ui::toHexString(emulator.getMemory().read(0xff22) & 0b111, true, 2) + "\n"
     "Length timer: " + ui::toHexString(emulator.getAPU().ch2_length_timer, true, 2) + "\n");
 
-    // Display.
-    sf::Image background_image;
-    sf::Image window_image;
-    background_image.create(emulator.getPPU().actual_screen_width, emulator.getPPU().actual_screen_height);
-    window_image.create(emulator.getPPU().actual_screen_width, emulator.getPPU().actual_screen_height);
-    for (int i = 0; i < emulator.getPPU().actual_screen_width; i++)
+    // Background and window. Only built while their panels are shown.
+    bool background_visible = background_panel->isVisible();
+    bool window_visible = window_panel->isVisible();
+    emulator.processScreenBuffers(background_visible, window_visible);
+    if(background_visible)
     {
-        for (int j = 0; j < emulator.getPPU().actual_screen_height; j++)
-        {
-            int color_index = emulator.getPPU().background_buffer[j * emulator.getPPU().actual_screen_width + i];
-            background_image.setPixel(i, j, (sf::Color)emulator.getPPU().getColorPalette()[color_index]);   
-
-            color_index = emulator.getPPU().window_buffer[j * emulator.getPPU().actual_screen_width + i];
-            window_image.setPixel(i, j, (sf::Color)emulator.getPPU().getColorPalette()[color_index]);
-        }
+        background_graphic_texture.update(reinterpret_cast<const sf::Uint8*>(emulator.getPPU().background_view.pixels.data()));
+        background_graphic->setTexture(&background_graphic_texture);
     }
-
-    background_graphic_texture.loadFromImage(background_image);
-    background_graphic->setTexture(&background_graphic_texture);
-
-    window_graphic_texture.loadFromImage(window_image);
-    window_graphic->setTexture(&window_graphic_texture);
-
-    sf::Image display_image;
-    display_image.create(emulator.getPPU().screen_width, emulator.getPPU().screen_height);
-    for (int i = 0; i < emulator.getPPU().screen_width; i++)
+    if(window_visible)
     {
-        for (int j = 0; j < emulator.getPPU().screen_height; j++)
-        {
-            int color_index = emulator.getPPU().screen_buffer[j * emulator.getPPU().screen_width + i];
-            display_image.setPixel(i, j, (sf::Color)emulator.getPPU().getColorPalette()[color_index]);    
-        }
+        window_graphic_texture.update(reinterpret_cast<const sf::Uint8*>(emulator.getPPU().window_view.pixels.data()));
+        window_graphic->setTexture(&window_graphic_texture);
     }
-    
-    display_graphic_texture.loadFromImage(display_image);
-    display_graphic->setTexture(&display_graphic_texture);
 
     // Cartridge.
     metrics_text->setString("dots/sec: " + ui::toString(emulator.cycle_count_per_second) + "\n"
     "Speed: " + ui::toString((emulator.cycle_count_per_second / 4194304.f) * 100.f, 1) + "%\n"
-    "Cycle budget: " + ui::toString(emulator.cycle_budget, 1) + "\n");
+    "Cycle budget: " + ui::toString(emulator.getCycleBudget(), 1) + "\n"
+    "Audio latency: " + ui::toString(emulator.getAPU().getLatency() * 1000.f, 1) + " ms, underruns: " + ui::toString(emulator.getAPU().getUnderruns()) + "\n");
 
     // CPU.
-    cpu_text->setString(
+    sf::String cpu_string = 
         "af: " + ui::toHexString(emulator.getCPU().a << 4 | emulator.getCPU().flags, true, 4, "0x") + "\n"
         "bc: " + ui::toHexString(emulator.getCPU().b << 4 | emulator.getCPU().c, true, 4, "0x") + "\n"
         "de: " + ui::toHexString(emulator.getCPU().d << 4 | emulator.getCPU().e, true, 4, "0x") + "\n"
@@ -426,7 +465,15 @@ void Debugger::updateLogic()
             + "   subtraction n = " + ((emulator.getCPU().flags & 0b01000000) ? "true" : "false") + "\n"
             + "   half carry h  = " + ((emulator.getCPU().flags & 0b00100000) ? "true" : "false") + "\n"
             + "   carry c       = " + ((emulator.getCPU().flags & 0b00010000) ? "true" : "false") + "\n"
-        "JOYP (0xff00):" + ui::toHexString(emulator.getMemory().read(0xff00), true, 2, "0x") + " - " + ui::toBinaryString(emulator.getMemory().read(0xff00), 8, "0b"));
+        "JOYP (0xff00):" + ui::toHexString(emulator.getMemory().read(0xff00), true, 2, "0x") + " - " + ui::toBinaryString(emulator.getMemory().read(0xff00), 8, "0b");
+    if constexpr(debug_probes_enabled)
+    {
+        const CPUProbe& cpu_probe = emulator.getCPU().probe;
+        const SHARP_LR35902::Instruction& instruction = cpu_probe.prefixed ? emulator.getCPU().prefix_instruction_table[cpu_probe.opcode] : emulator.getCPU().instruction_table[cpu_probe.opcode];
+        cpu_string += "\n\nLast instruction: " + instruction.name + " at " + ui::toHexString(cpu_probe.address, true, 4, "0x") + " (" + ui::toString((int)cpu_probe.cycles) + " cycles)\n"
+            "Instructions: " + ui::toString(cpu_probe.instruction_count);
+    }
+    cpu_text->setString(cpu_string);
     cpu_text->setSize(cpu_panel->getSize());
 
     // VRAM (0x8000-0x97ff -> There are 384 tiles, each 8x8 pixels)
@@ -526,17 +573,22 @@ void Debugger::updateLogic()
     ppu_info_string += sf::String("Window internal counter: ") + ui::toHexString(emulator.getPPU().window_internal_counter, true, 2) + "\n";
     ppu_info_string += "Pixels to erase: " + ui::toHexString(emulator.getPPU().scroll_x % 8, true, 2) + "\n";
     
-    ppu_info_string += "Objects on scanline: " + ui::toString(emulator.getPPU().objects_on_scanline.size()) + "\n";
-    for (int i = 0; i < emulator.getPPU().objects_on_scanline.size(); i++)
-    {
-        ppu_info_string += ui::toString(i) + ". x=" + std::to_string(emulator.getPPU().objects_on_scanline[i].x) + " y=" + std::to_string(emulator.getPPU().objects_on_scanline[i].y) + "\n";
-    }
-    ppu_info_string += "FIFO size: " + ui::toString(emulator.getPPU().fifo.size()) + "\n";
-    for (int i = 0; i < emulator.getPPU().fifo.size(); i++)
+    if constexpr(debug_probes_enabled)
     {
-        ppu_info_string += ui::toString(i) + ". color=" + ui::toString(emulator.getPPU().fifo[i].color) + "\n";
+        const PPUProbe& ppu_probe = emulator.getPPU().probe;
+        ppu_info_string += "Objects on scanline: " + ui::toString(ppu_probe.object_count) + "\n";
+        for (int i = 0; i < ppu_probe.object_count; i++)
+        {
+            ppu_info_string += ui::toString(i) + ". x=" + std::to_string(ppu_probe.object_x[i]) + " y=" + std::to_string(ppu_probe.object_y[i]) + "\n";
+        }
+        ppu_info_string += "FIFO size: " + ui::toString(ppu_probe.fifo_size) + "\n";
+        for (int i = 0; i < ppu_probe.fifo_size; i++)
+        {
+            ppu_info_string += ui::toString(i) + ". color=" + ui::toString((int)ppu_probe.fifo_colors[i]) + "\n";
+        }
+        ppu_info_string += ui::toString(ppu_probe.tile_x) + ", " + ui::toString(ppu_probe.tile_y) + ": TileMap " + ui::toString(ppu_probe.tile_map_address) + " Offset " + ui::toString((int)ppu_probe.tile_index) 
+            + " TilePointer " + ui::toString(ppu_probe.tile_data_address) + " TileRow " + ui::toString(ppu_probe.tile_row) + " TileData " + ui::toString((int)ppu_probe.tile_data_low) + ", " + ui::toString((int)ppu_probe.tile_data_high) + "\n";
     }
-    ppu_info_string += emulator.getPPU().info_text;
     
     
     ppu_info->setString(ppu_info_string);
@@ -0,0 +1,255 @@
+#include "wav_recorder.hpp"
+
+#include <fstream>
+#include <memory>
+#include <iostream>
+
+namespace
+{
+    void putLE(std::ofstream& p_file, uint32_t p_value, int p_bytes)
+    {
+        for (int i = 0; i < p_bytes; i++)
+        {
+            p_file.put((p_value >> (i * 8)) & 0xff);
+        }
+    }
+
+    // Writes a header for 16 bit mono PCM. The sizes are filled in by finishHeader() once the recording ended.
+    void writeHeader(std::ofstream& p_file, int p_sample_rate)
+    {
+        p_file.write("RIFF", 4);
+        putLE(p_file, 0, 4);
+        p_file.write("WAVE", 4);
+        p_file.write("fmt ", 4);
+        putLE(p_file, 16, 4); // Size of the format chunk.
+        putLE(p_file, 1, 2); // PCM.
+        putLE(p_file, 1, 2); // Channels.
+        putLE(p_file, p_sample_rate, 4);
+        putLE(p_file, p_sample_rate * 2, 4); // Bytes per second.
+        putLE(p_file, 2, 2); // Bytes per frame.
+        putLE(p_file, 16, 2); // Bits per sample.
+        p_file.write("data", 4);
+        putLE(p_file, 0, 4);
+    }
+
+    void finishHeader(std::ofstream& p_file, uint32_t p_data_size)
+    {
+        p_file.seekp(4);
+        putLE(p_file, 36 + p_data_size, 4);
+        p_file.seekp(40);
+        putLE(p_file, p_data_size, 4);
+    }
+}
+
+WavRecorder::~WavRecorder()
+{
+    stop();
+    if(thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool WavRecorder::start(const std::string& p_path, int p_sample_rate, bool p_stems)
+{
+    if(recording)
+    {
+        return false;
+    }
+
+    // The writer of the previous recording finishes its files and releases the pool before it ends.
+    if(thread.joinable())
+    {
+        thread.join();
+    }
+
+    recording = true;
+    streams = p_stems ? stem_count : 1;
+    dropped_frames = 0;
+
+    blocks.resize(block_count);
+    for (Block& block : blocks)
+    {
+        block.samples.resize(block_frames * streams);
+        free_blocks.push_back(&block);
+    }
+    thread = std::thread(&WavRecorder::worker, this);
+
+    Command command;
+    command.type = Command::START;
+    command.path = p_path;
+    command.sample_rate = p_sample_rate;
+    command.streams = streams;
+    pushCommand(command);
+    return true;
+}
+
+void WavRecorder::stop()
+{
+    if(!recording)
+    {
+        return;
+    }
+
+    if(current_block)
+    {
+        Command command;
+        command.type = Command::WRITE;
+        command.block = current_block;
+        pushCommand(command);
+        current_block = nullptr;
+    }
+
+    Command command;
+    command.type = Command::STOP;
+    pushCommand(command);
+    recording = false;
+}
+
+void WavRecorder::write(const int16_t* p_frame)
+{
+    if(!recording)
+    {
+        return;
+    }
+
+    if(!current_block)
+    {
+        queue_mutex.lock();
+        if(!free_blocks.empty())
+        {
+            current_block = free_blocks.back();
+            current_block->frames = 0;
+            free_blocks.pop_back();
+        }
+        queue_mutex.unlock();
+
+        if(!current_block)
+        {
+            dropped_frames++;
+            return;
+        }
+    }
+
+    int16_t* samples = &current_block->samples[current_block->frames * streams];
+    for (int i = 0; i < streams; i++)
+    {
+        samples[i] = p_frame[i];
+    }
+    current_block->frames++;
+
+    if(current_block->frames == block_frames)
+    {
+        Command command;
+        command.type = Command::WRITE;
+        command.block = current_block;
+        pushCommand(command);
+        current_block = nullptr;
+    }
+}
+
+bool WavRecorder::isRecording() const
+{
+    return recording;
+}
+
+int WavRecorder::getStreamCount() const
+{
+    return streams;
+}
+
+uint64_t WavRecorder::getDroppedFrames() const
+{
+    return dropped_frames;
+}
+
+void WavRecorder::pushCommand(const Command& p_command)
+{
+    queue_mutex.lock();
+    commands.push_back(p_command);
+    queue_mutex.unlock();
+    queue_condition.notify_one();
+}
+
+void WavRecorder::worker()
+{
+    std::vector<std::unique_ptr<std::ofstream>> files;
+    uint32_t data_size = 0;
+    int file_streams = 1;
+    std::vector<char> bytes;
+
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_condition.wait(lock, [this](){ return !commands.empty(); });
+        Command command = commands.front();
+        commands.pop_front();
+        lock.unlock();
+
+        if(command.type == Command::START)
+        {
+            files.clear();
+            data_size = 0;
+            file_streams = command.streams;
+
+            // Stems are named after the given path: name.wav -> name_mix.wav, name_ch1.wav, ...
+            std::string base = command.path;
+            std::string extension = ".wav";
+            size_t dot = base.rfind('.');
+            if(dot != std::string::npos)
+            {
+                extension = base.substr(dot);
+                base = base.substr(0, dot);
+            }
+            for (int i = 0; i < file_streams; i++)
+            {
+                std::string path = command.path;
+                if(file_streams > 1)
+                {
+                    path = base + (i == 0 ? "_mix" : "_ch" + std::to_string(i)) + extension;
+                }
+                files.push_back(std::make_unique<std::ofstream>(path, std::ios::out | std::ios::binary));
+                if(!*files.back())
+                {
+                    std::cout << "Could not open " << path << " for recording." << std::endl;
+                }
+                writeHeader(*files.back(), command.sample_rate);
+            }
+        }
+        else if(command.type == Command::WRITE)
+        {
+            // Deinterleave the frames into the files as 16 bit little-endian samples.
+            Block* block = command.block;
+            bytes.resize(block->frames * 2);
+            for (int stream = 0; stream < file_streams && stream < (int)files.size(); stream++)
+            {
+                for (int i = 0; i < block->frames; i++)
+                {
+                    uint16_t sample = block->samples[i * file_streams + stream];
+                    bytes[i * 2] = sample & 0xff;
+                    bytes[i * 2 + 1] = sample >> 8;
+                }
+                files[stream]->write(bytes.data(), bytes.size());
+            }
+            data_size += block->frames * 2;
+
+            lock.lock();
+            free_blocks.push_back(block);
+            lock.unlock();
+        }
+        else if(command.type == Command::STOP)
+        {
+            for (std::unique_ptr<std::ofstream>& file : files)
+            {
+                finishHeader(*file, data_size);
+            }
+            files.clear();
+
+            // The recording is complete, nothing uses the pool until the next start() (which waits for this thread to end).
+            lock.lock();
+            free_blocks = std::vector<Block*>();
+            blocks = std::vector<Block>();
+            return;
+        }
+    }
+}
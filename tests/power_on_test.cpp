@@ -0,0 +1,45 @@
+#include "emulator.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/*
+Checks that the PPU runs right after a reset, without the game writing LCDC. Games rely on the state the boot ROM leaves behind and often
+wait for VBLANK (by polling LY or through the interrupt) before they touch LCDC.
+*/
+int main()
+{
+    // A ROM that only loops at the entry point (jp 0x0100).
+    std::vector<char> rom(32 * 1024, 0);
+    rom[0x100] = (char)0xc3;
+    rom[0x101] = 0x00;
+    rom[0x102] = 0x01;
+    const std::string rom_path = "power_on_test.gb";
+    std::ofstream(rom_path, std::ios::binary).write(rom.data(), rom.size());
+
+    std::mutex mutex;
+    Emulator emulator(mutex);
+    emulator.loadCartridge(rom_path);
+    emulator.reset();
+
+    // One frame takes 70224 dots, so VBLANK has to start within the first frame.
+    int dots = 0;
+    while(!(emulator.getMemory().read(0xff0f) & SHARP_LR35902::VBLANK) && dots < 70224)
+    {
+        dots += emulator.step();
+    }
+
+    if(!(emulator.getMemory().read(0xff0f) & SHARP_LR35902::VBLANK))
+    {
+        std::cout << "No VBLANK interrupt was requested within a frame after a reset (LY = " << (int)emulator.getMemory().read(0xff44) << ")." << std::endl;
+        return 1;
+    }
+    if(emulator.getMemory().read(0xff44) != 144)
+    {
+        std::cout << "VBLANK was requested at line " << (int)emulator.getMemory().read(0xff44) << " instead of 144." << std::endl;
+        return 1;
+    }
+    std::cout << "Line 144 reached after " << dots << " dots." << std::endl;
+    return 0;
+}